@@ -0,0 +1,811 @@
+// bench - microbenchmarks of the dictionary and the segmentation engines (Google Benchmark).
+//
+// Usage: make bench && build/bench [--benchmark_filter=...]
+//
+// Without configuration every benchmark runs on a synthetic, deterministic dictionary and corpus. Real data is picked
+// up from the environment:
+//   SENTENCE_BREAKER_BENCH_DICT    word list, replaces the synthetic dictionary
+//   SENTENCE_BREAKER_BENCH_CORPUS  whitespace separated text of concatenated tokens, for BM_BreakSentence_Corpus
+//
+// Rates are reported per character and per word next to the time per iteration, so runs over different data
+// stay comparable. The lookup and segmentation benchmarks also report L1 data and last level cache misses per
+// character where the kernel exposes hardware counters (see CACHE_COUNTERS).
+
+#include <benchmark/benchmark.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../dictionary.hpp"
+#include "../break_sentence.hpp"
+#include "../break_sentences.hpp"
+#include "../normalize.hpp"
+
+using namespace SENTENCE_BREAKER;
+
+namespace
+{
+
+// Everything the benchmarks share, built once on first use
+struct BENCH_DATA
+{
+	BENCH_DATA();
+	~BENCH_DATA();
+
+	std::string word_list;                       // File the dictionary is loaded from
+	bool owns_word_list;                         // The synthetic word list is a temporary file
+	std::vector<std::string> words;
+	std::unique_ptr<DICTIONARY> dict;
+	std::unique_ptr<DICTIONARY> linked_dict;     // The same words with match links
+
+	std::vector<std::string> hits;               // Whole words
+	std::vector<std::string> misses;             // Words with one character changed so they fall off the trie
+	std::vector<std::string> deep_prefixes;      // Long prefixes of long words, that are not words themselves
+	std::vector<std::string> shuffled_hits;      // hits in random order, so that consecutive queries share no path
+
+	std::vector<std::string> synthetic_corpus;   // Tokens of a few random words each
+	std::vector<std::string> corpus;             // Tokens of SENTENCE_BREAKER_BENCH_CORPUS, if set
+};
+
+// Words are strung together from syllables, so they share prefixes and suffixes the way a natural language list does
+std::vector<std::string> synthetic_words(std::size_t count)
+{
+	static const char * const SYLLABLES[] =
+	{
+		"a", "an", "ar", "ba", "be", "ca", "con", "de", "di", "er", "es", "ful", "ge", "in", "ing", "ion", "is",
+		"ka", "la", "le", "less", "li", "ly", "ma", "ment", "mi", "na", "ness", "no", "o", "or", "pa", "per", "pre",
+		"pro", "ra", "re", "ri", "sa", "se", "st", "ta", "te", "ter", "ti", "tion", "to", "un", "ve", "wa"
+	};
+	const std::size_t num_syllables = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+
+	std::mt19937 rng(12345);
+	std::vector<std::string> words;
+	words.reserve(count);
+	while (words.size() < count)
+	{
+		std::string word;
+		const std::size_t length = 1 + rng() % 4;
+		for (std::size_t syllable = 0; syllable < length; ++syllable)
+		{
+			word += SYLLABLES[rng() % num_syllables];
+		}
+		words.push_back(word);
+	}
+	std::sort(words.begin(), words.end());
+	words.erase(std::unique(words.begin(), words.end()), words.end());
+	return words;
+}
+
+std::vector<std::string> read_tokens(const char * filename)
+{
+	std::ifstream ifs(filename);
+	if (!ifs)
+	{
+		std::fprintf(stderr, "bench: cannot open %s\n", filename);
+		std::exit(1);
+	}
+	std::vector<std::string> tokens;
+	std::string token;
+	while (ifs >> token)
+	{
+		tokens.push_back(token);
+	}
+	return tokens;
+}
+
+BENCH_DATA::BENCH_DATA()
+:
+	owns_word_list(false)
+{
+	const char * const real_word_list = std::getenv("SENTENCE_BREAKER_BENCH_DICT");
+	if (real_word_list != nullptr)
+	{
+		word_list = real_word_list;
+		words = read_tokens(real_word_list);
+	}
+	else
+	{
+		words = synthetic_words(200000);
+
+		char temp_name[] = "/tmp/sentence_breaker_bench_XXXXXX";
+		const int fd = mkstemp(temp_name);
+		if (fd < 0)
+		{
+			std::perror("bench: mkstemp");
+			std::exit(1);
+		}
+		close(fd);
+		word_list = temp_name;
+		owns_word_list = true;
+
+		std::ofstream ofs(word_list);
+		for (const std::string & word : words)
+		{
+			ofs << word << '\n';
+		}
+	}
+	dict.reset(new DICTIONARY(word_list.c_str()));
+	DICTIONARY::LOAD_OPTIONS link_options;
+	link_options.match_links = true;
+	linked_dict.reset(new DICTIONARY(word_list.c_str(), link_options));
+
+	std::mt19937 rng(54321);
+	for (const std::string & word : words)
+	{
+		hits.push_back(word);
+
+		std::string miss = word;
+		for (int attempt = 0; attempt < 8; ++attempt)
+		{
+			miss[rng() % miss.size()] = static_cast<char>('a' + rng() % 26);
+			if (!dict->prefix_match(miss.cbegin(), miss.cend()).first && !dict->prefix_match(miss.cbegin(), miss.cend()).second)
+			{
+				misses.push_back(miss);
+				break;
+			}
+		}
+
+		if (word.size() >= 8)
+		{
+			const std::string prefix = word.substr(0, word.size() - 1);
+			const std::pair<bool, bool> match = dict->prefix_match(prefix.cbegin(), prefix.cend());
+			if (!match.first && match.second)
+			{
+				deep_prefixes.push_back(prefix);
+			}
+		}
+	}
+
+	shuffled_hits = hits;
+	std::shuffle(shuffled_hits.begin(), shuffled_hits.end(), rng);
+
+	for (std::size_t token = 0; token < 20000; ++token)
+	{
+		std::string concatenated;
+		const std::size_t num_words = 2 + rng() % 7;
+		for (std::size_t word = 0; word < num_words; ++word)
+		{
+			concatenated += words[rng() % words.size()];
+		}
+		synthetic_corpus.push_back(concatenated);
+	}
+
+	const char * const real_corpus = std::getenv("SENTENCE_BREAKER_BENCH_CORPUS");
+	if (real_corpus != nullptr)
+	{
+		corpus = read_tokens(real_corpus);
+	}
+}
+
+BENCH_DATA::~BENCH_DATA()
+{
+	if (owns_word_list)
+	{
+		std::remove(word_list.c_str());
+	}
+}
+
+const BENCH_DATA & bench_data()
+{
+	static const BENCH_DATA data;
+	return data;
+}
+
+std::size_t total_length(const std::vector<std::string> & strings)
+{
+	std::size_t length = 0;
+	for (const std::string & string : strings)
+	{
+		length += string.size();
+	}
+	return length;
+}
+
+// L1 data and last level cache read misses of the calling thread, through perf_event_open. Where there are no
+// hardware counters (most VMs, a high perf_event_paranoid) the benchmarks run as usual and leave them out.
+// There is no generic event for L2: L1 misses that the last level never sees are L2 hits on a three level part.
+class CACHE_COUNTERS
+{
+public:
+	CACHE_COUNTERS()
+	:
+		m_fds{ { open_counter(PERF_COUNT_HW_CACHE_L1D), open_counter(PERF_COUNT_HW_CACHE_LL) } }
+	{
+
+	}
+
+	~CACHE_COUNTERS()
+	{
+		for (int fd : m_fds)
+		{
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+		}
+	}
+
+	CACHE_COUNTERS(const CACHE_COUNTERS &) = delete;
+	CACHE_COUNTERS & operator=(const CACHE_COUNTERS &) = delete;
+
+	void start()
+	{
+		for (int fd : m_fds)
+		{
+			if (fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+	}
+
+	void stop()
+	{
+		for (int fd : m_fds)
+		{
+			if (fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+	}
+
+	// Misses per character since start(), as the L1D-miss/char and LL-miss/char counters of the benchmark
+	void report(benchmark::State & state, double chars) const
+	{
+		static const char * const NAMES[] = { "L1D-miss/char", "LL-miss/char" };
+		for (std::size_t counter = 0; counter < m_fds.size(); ++counter)
+		{
+			std::uint64_t misses;
+			if (m_fds[counter] >= 0 && read(m_fds[counter], &misses, sizeof(misses)) == static_cast<ssize_t>(sizeof(misses)))
+			{
+				state.counters[NAMES[counter]] = static_cast<double>(misses) / chars;
+			}
+		}
+	}
+
+private:
+	static int open_counter(std::uint64_t cache)
+	{
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size           = sizeof(attr);
+		attr.type           = PERF_TYPE_HW_CACHE;
+		attr.config         = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attr.disabled       = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv     = 1;
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+
+	std::array<int, 2> m_fds;  // -1 where the counter isn't available
+};
+
+// chars/s and words/s, plus the inverse of the character rate (seconds per character)
+void set_rates(benchmark::State & state, double chars, double words)
+{
+	state.counters["chars/s"] = benchmark::Counter(chars, benchmark::Counter::kIsRate);
+	state.counters["words/s"] = benchmark::Counter(words, benchmark::Counter::kIsRate);
+	state.counters["s/char"]  = benchmark::Counter(chars, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+// Arg: 0 for the plain trie, 1 for a minimized DAWG, 2 for the plain trie with match links
+void BM_Load(benchmark::State & state)
+{
+	const BENCH_DATA & data = bench_data();
+	DICTIONARY::LOAD_OPTIONS options;
+	options.minimize = state.range(0) == 1;
+	options.match_links = state.range(0) == 2;
+
+	std::size_t num_nodes = 0, byte_size = 0;
+	for (auto _ : state)
+	{
+		DICTIONARY dict(data.word_list.c_str(), options);
+		num_nodes = dict.num_nodes();
+		byte_size = dict.byte_size();
+		benchmark::DoNotOptimize(num_nodes);
+	}
+
+	const double passes = static_cast<double>(state.iterations());
+	set_rates(state, passes * static_cast<double>(total_length(data.words)), passes * static_cast<double>(data.words.size()));
+	state.counters["nodes"] = static_cast<double>(num_nodes);
+	state.counters["bytes"] = static_cast<double>(byte_size);
+}
+BENCHMARK(BM_Load)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond);
+
+// One iteration is a pass over every query
+void prefix_match_pass(benchmark::State & state, const std::vector<std::string> & queries,
+	const DICTIONARY & dict = *bench_data().dict)
+{
+	CACHE_COUNTERS cache_counters;
+	cache_counters.start();
+	for (auto _ : state)
+	{
+		for (const std::string & query : queries)
+		{
+			benchmark::DoNotOptimize(dict.prefix_match(query.cbegin(), query.cend()));
+		}
+	}
+	cache_counters.stop();
+
+	const double passes = static_cast<double>(state.iterations());
+	set_rates(state, passes * static_cast<double>(total_length(queries)), passes * static_cast<double>(queries.size()));
+	cache_counters.report(state, passes * static_cast<double>(total_length(queries)));
+}
+
+void BM_PrefixMatch_Hit(benchmark::State & state)
+{
+	prefix_match_pass(state, bench_data().hits);
+}
+BENCHMARK(BM_PrefixMatch_Hit)->Unit(benchmark::kMillisecond);
+
+void BM_PrefixMatch_Miss(benchmark::State & state)
+{
+	prefix_match_pass(state, bench_data().misses);
+}
+BENCHMARK(BM_PrefixMatch_Miss)->Unit(benchmark::kMillisecond);
+
+void BM_PrefixMatch_DeepPrefix(benchmark::State & state)
+{
+	prefix_match_pass(state, bench_data().deep_prefixes);
+}
+BENCHMARK(BM_PrefixMatch_DeepPrefix)->Unit(benchmark::kMillisecond);
+
+void BM_PrefixMatch_Shuffled(benchmark::State & state)
+{
+	prefix_match_pass(state, bench_data().shuffled_hits);
+}
+BENCHMARK(BM_PrefixMatch_Shuffled)->Unit(benchmark::kMillisecond);
+
+// The same passes through prefix_match_batch, a call per BATCH queries; compare with BM_PrefixMatch_Hit, _Shuffled
+// and _Miss. Arg: 0 for hits, 1 for shuffled hits, 2 for misses.
+void BM_PrefixMatch_Batch(benchmark::State & state)
+{
+	static const std::size_t BATCH = 256;
+	const BENCH_DATA & data = bench_data();
+	const std::vector<std::string> & queries = state.range(0) == 0 ? data.hits
+		: state.range(0) == 1 ? data.shuffled_hits : data.misses;
+	const DICTIONARY & dict = *data.dict;
+	std::vector<std::pair<bool, bool>> results(BATCH);
+
+	CACHE_COUNTERS cache_counters;
+	cache_counters.start();
+	for (auto _ : state)
+	{
+		for (std::size_t first = 0; first < queries.size(); first += BATCH)
+		{
+			dict.prefix_match_batch(queries.data() + first, std::min(BATCH, queries.size() - first), results.data());
+			benchmark::DoNotOptimize(results.data());
+		}
+	}
+	cache_counters.stop();
+
+	const double passes = static_cast<double>(state.iterations());
+	set_rates(state, passes * static_cast<double>(total_length(queries)), passes * static_cast<double>(queries.size()));
+	cache_counters.report(state, passes * static_cast<double>(total_length(queries)));
+}
+BENCHMARK(BM_PrefixMatch_Batch)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond);
+
+// The bitmap indexed node layout that DOUBLE_ARRAY_TRIE was measured against, kept here so that measurement can be
+// re-run rather than taken on trust. Every node is 8 bytes: a 26 bit child mask (bit 31 set for a word) and the index
+// of its first child. The children of a node are stored next to each other, blocks breadth first, and the child on
+// letter c is found by counting the mask bits below c, so the popcount sits between the load of a node and the load
+// of its child. Letters a-z only: a word with any other byte is left out, and a query falls off the trie at one.
+//
+// Minimized, it shares suffixes the way LOAD_OPTIONS::minimize does: equivalent nodes (same is_word, same keys to
+// equivalent children) become one class with one children block, which every node of the class points at.
+class BITMAP_TRIE
+{
+public:
+	BITMAP_TRIE(std::vector<std::string> words, bool minimize)
+	:
+		m_nodes()
+	{
+		for (std::string & word : words)
+		{
+			for (char & c : word)
+			{
+				c = fold_ascii(c);
+			}
+		}
+		words.erase(std::remove_if(words.begin(), words.end(), [](const std::string & word)
+		{
+			return std::any_of(word.begin(), word.end(), [](char c) { return c < 'a' || c > 'z'; });
+		}), words.end());
+		std::sort(words.begin(), words.end());
+		words.erase(std::unique(words.begin(), words.end()), words.end());
+
+		std::vector<CLASS> classes;
+		std::map<std::vector<std::uint32_t>, std::uint32_t> known;
+		const std::uint32_t root = add_class(words, 0, words.size(), 0, minimize, classes, known);
+
+		// Blocks breadth first over the classes, each placed once; the root's node is slot 0
+		std::vector<std::uint32_t> first_child(classes.size(), 0);
+		std::vector<bool> placed(classes.size(), false);
+		std::vector<std::uint32_t> order(1, root);
+		placed[root] = true;
+		std::uint32_t num_nodes = 1;
+		for (std::size_t head = 0; head < order.size(); ++head)
+		{
+			const CLASS & node_class = classes[order[head]];
+			first_child[order[head]] = num_nodes;
+			num_nodes += static_cast<std::uint32_t>(node_class.children.size());
+			for (const std::uint32_t child : node_class.children)
+			{
+				if (!placed[child])
+				{
+					placed[child] = true;
+					order.push_back(child);
+				}
+			}
+		}
+
+		m_nodes.resize(num_nodes);
+		m_nodes[0] = NODE{ classes[root].mask, first_child[root] };
+		for (const std::uint32_t class_index : order)
+		{
+			const CLASS & node_class = classes[class_index];
+			for (std::size_t child = 0; child < node_class.children.size(); ++child)
+			{
+				const std::uint32_t child_class = node_class.children[child];
+				m_nodes[first_child[class_index] + child] = NODE{ classes[child_class].mask, first_child[child_class] };
+			}
+		}
+	}
+
+	// Same answers as DICTIONARY::prefix_match for queries of a-z
+	template <typename POPCOUNT>
+	std::pair<bool, bool> prefix_match(const std::string & query, POPCOUNT popcount) const
+	{
+		std::uint32_t node = 0;
+		for (const char c : query)
+		{
+			const unsigned key = static_cast<unsigned char>(fold_ascii(c)) - 'a';
+			const std::uint32_t mask = m_nodes[node].mask;
+			if (key >= 26 || !(mask & (1u << key)))
+			{
+				return std::make_pair(false, false);
+			}
+			node = m_nodes[node].first_child + popcount(mask & ((1u << key) - 1));
+		}
+		return std::make_pair((m_nodes[node].mask & IS_WORD_BIT) != 0, (m_nodes[node].mask & CHILD_MASK) != 0);
+	}
+
+	std::size_t byte_size() const
+	{
+		return m_nodes.size() * sizeof(NODE);
+	}
+
+private:
+	static constexpr std::uint32_t IS_WORD_BIT = std::uint32_t(1) << 31;
+	static constexpr std::uint32_t CHILD_MASK  = (std::uint32_t(1) << 26) - 1;
+
+	struct NODE
+	{
+		std::uint32_t mask;
+		std::uint32_t first_child;
+	};
+
+	// A node, or with minimize every node with the same mask and children classes
+	struct CLASS
+	{
+		std::uint32_t mask;
+		std::vector<std::uint32_t> children;  // In key order
+	};
+
+	// Class of the node that the sorted words [begin, end) run through at depth, built bottom up
+	static std::uint32_t add_class(const std::vector<std::string> & words, std::size_t begin, std::size_t end,
+		std::size_t depth, bool minimize, std::vector<CLASS> & classes,
+		std::map<std::vector<std::uint32_t>, std::uint32_t> & known)
+	{
+		CLASS node_class{ 0, std::vector<std::uint32_t>() };
+		if (begin != end && words[begin].size() == depth)
+		{
+			node_class.mask |= IS_WORD_BIT;
+			++begin;
+		}
+		while (begin != end)
+		{
+			const char key = words[begin][depth];
+			std::size_t key_end = begin;
+			while (key_end != end && words[key_end][depth] == key)
+			{
+				++key_end;
+			}
+			node_class.mask |= 1u << (key - 'a');
+			node_class.children.push_back(add_class(words, begin, key_end, depth + 1, minimize, classes, known));
+			begin = key_end;
+		}
+
+		if (minimize)
+		{
+			std::vector<std::uint32_t> signature(1, node_class.mask);
+			signature.insert(signature.end(), node_class.children.begin(), node_class.children.end());
+			const auto found = known.emplace(std::move(signature), static_cast<std::uint32_t>(classes.size()));
+			if (!found.second)
+			{
+				return found.first->second;
+			}
+		}
+		classes.push_back(std::move(node_class));
+		return static_cast<std::uint32_t>(classes.size() - 1);
+	}
+
+	std::vector<NODE> m_nodes;
+};
+
+const BITMAP_TRIE & bitmap_trie(bool minimize)
+{
+	static const BITMAP_TRIE plain(bench_data().words, false);
+	static const BITMAP_TRIE minimized(bench_data().words, true);
+	return minimize ? minimized : plain;
+}
+
+// The benchmark data's words as a DAWG, to hold the minimized bitmap trie against
+const DICTIONARY & minimized_dictionary()
+{
+	static const DICTIONARY dict = []()
+	{
+		DICTIONARY::LOAD_OPTIONS options;
+		options.minimize = true;
+		return DICTIONARY(bench_data().word_list.c_str(), options);
+	}();
+	return dict;
+}
+
+// Popcount without the instruction, for CPUs (and builds) without POPCNT
+unsigned swar_popcount(std::uint32_t x)
+{
+	x = x - ((x >> 1) & 0x55555555u);
+	x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+	x = (x + (x >> 4)) & 0x0f0f0f0fu;
+	return (x * 0x01010101u) >> 24;
+}
+
+template <typename POPCOUNT>
+void bitmap_pass(benchmark::State & state, const BITMAP_TRIE & trie, const std::vector<std::string> & queries,
+	POPCOUNT popcount)
+{
+	CACHE_COUNTERS cache_counters;
+	cache_counters.start();
+	for (auto _ : state)
+	{
+		for (const std::string & query : queries)
+		{
+			benchmark::DoNotOptimize(trie.prefix_match(query, popcount));
+		}
+	}
+	cache_counters.stop();
+
+	const double passes = static_cast<double>(state.iterations());
+	set_rates(state, passes * static_cast<double>(total_length(queries)), passes * static_cast<double>(queries.size()));
+	cache_counters.report(state, passes * static_cast<double>(total_length(queries)));
+}
+
+// The builtin is expanded once inlined here, so it becomes the POPCNT instruction whatever the build targets, the
+// same code as the whole bench built with -mpopcnt
+__attribute__((target("popcnt")))
+void bitmap_pass_hardware(benchmark::State & state, const BITMAP_TRIE & trie, const std::vector<std::string> & queries)
+{
+	bitmap_pass(state, trie, queries, [](std::uint32_t x) { return static_cast<unsigned>(__builtin_popcount(x)); });
+}
+
+// Both layouts on equal terms, on the passes of BM_PrefixMatch_Hit, _Miss and _DeepPrefix.
+// Args: 0 for hits, 1 for misses, 2 for deep prefixes; then the layout, 0 for DOUBLE_ARRAY_TRIE, 1 for the bitmap
+// trie with the POPCNT instruction, 2 for the bitmap trie with a SWAR popcount; then 1 for both minimized (sharing
+// suffixes as a DAWG), 0 for both plain. bytes is the layout's size. The double array's 8 byte slot also holds the
+// word's cost and completion, which the bitmap node has no room for.
+void BM_PrefixMatch_Bitmap(benchmark::State & state)
+{
+	const BENCH_DATA & data = bench_data();
+	const std::vector<std::string> & queries = state.range(0) == 0 ? data.hits
+		: state.range(0) == 1 ? data.misses : data.deep_prefixes;
+	const bool minimize = state.range(2) != 0;
+	const DICTIONARY & dict = minimize ? minimized_dictionary() : *data.dict;
+	const BITMAP_TRIE & trie = bitmap_trie(minimize);
+	for (const std::string & query : queries)
+	{
+		const bool ascii_letters = std::all_of(query.begin(), query.end(), [](char c)
+		{
+			return fold_ascii(c) >= 'a' && fold_ascii(c) <= 'z';
+		});
+		if (ascii_letters && trie.prefix_match(query, swar_popcount) != dict.prefix_match(query.cbegin(), query.cend()))
+		{
+			state.SkipWithError("bitmap trie disagrees with DICTIONARY");
+			return;
+		}
+	}
+
+	if (state.range(1) == 0)
+	{
+		prefix_match_pass(state, queries, dict);
+		state.counters["bytes"] = static_cast<double>(dict.byte_size());
+		return;
+	}
+	if (state.range(1) == 1)
+	{
+		if (!__builtin_cpu_supports("popcnt"))
+		{
+			state.SkipWithError("no POPCNT on this CPU");
+			return;
+		}
+		bitmap_pass_hardware(state, trie, queries);
+	}
+	else
+	{
+		bitmap_pass(state, trie, queries, swar_popcount);
+	}
+	state.counters["bytes"] = static_cast<double>(trie.byte_size());
+}
+BENCHMARK(BM_PrefixMatch_Bitmap)->ArgsProduct({ { 0, 1, 2 }, { 0, 1, 2 }, { 0, 1 } })->Unit(benchmark::kMillisecond);
+
+// The pre-pass alone over the synthetic corpus. Arg: 0 as is (all ASCII), 1 with every "u" spelled "\xc3\xbc" (u
+// umlaut), which takes the blocks around it off the SIMD path.
+void BM_FoldAndClassify(benchmark::State & state)
+{
+	std::vector<std::string> tokens = bench_data().synthetic_corpus;
+	if (state.range(0) != 0)
+	{
+		for (std::string & token : tokens)
+		{
+			for (std::size_t pos = token.find('u'); pos != std::string::npos; pos = token.find('u', pos + 2))
+			{
+				token.replace(pos, 1, "\xc3\xbc");
+			}
+		}
+	}
+
+	std::vector<char> folded;
+	std::vector<std::size_t> run_ends;
+	for (auto _ : state)
+	{
+		for (const std::string & token : tokens)
+		{
+			folded.resize(token.size());
+			benchmark::DoNotOptimize(fold_and_classify(token.data(), token.size(), folded.data(), run_ends));
+		}
+	}
+	set_rates(state, static_cast<double>(state.iterations()) * static_cast<double>(total_length(tokens)),
+		static_cast<double>(state.iterations()) * static_cast<double>(tokens.size()));
+}
+BENCHMARK(BM_FoldAndClassify)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// One iteration segments every token. Tokens without a split are counted, not timed separately.
+void break_sentence_pass(benchmark::State & state, const DICTIONARY & dict, const std::vector<std::string> & tokens,
+	SEGMENTATION_MODE mode)
+{
+	std::vector<WORD_SPAN> spans;
+	std::size_t num_words = 0, num_failed = 0;
+	CACHE_COUNTERS cache_counters;
+	cache_counters.start();
+	for (auto _ : state)
+	{
+		for (const std::string & token : tokens)
+		{
+			try
+			{
+				break_sentence(spans, token, dict, mode);
+				num_words += spans.size();
+			}
+			catch (const EXCEPTIONS::IMPOSSIBLE_MATCH_EXCEPTION &)
+			{
+				++num_failed;
+			}
+		}
+	}
+	cache_counters.stop();
+
+	const double passes = static_cast<double>(state.iterations());
+	set_rates(state, passes * static_cast<double>(total_length(tokens)), static_cast<double>(num_words));
+	cache_counters.report(state, passes * static_cast<double>(total_length(tokens)));
+	state.counters["failed"] = static_cast<double>(num_failed) / passes;
+}
+
+// Arg: SEGMENTATION_MODE
+void BM_BreakSentence_Synthetic(benchmark::State & state)
+{
+	break_sentence_pass(state, *bench_data().dict, bench_data().synthetic_corpus,
+		static_cast<SEGMENTATION_MODE>(state.range(0)));
+}
+BENCHMARK(BM_BreakSentence_Synthetic)
+	->Arg(static_cast<int>(SEGMENTATION_MODE::GREEDY))
+	->Arg(static_cast<int>(SEGMENTATION_MODE::FEWEST_WORDS))
+	->Arg(static_cast<int>(SEGMENTATION_MODE::UNIGRAM_COST))
+	->Unit(benchmark::kMillisecond);
+
+void BM_BreakSentence_Corpus(benchmark::State & state)
+{
+	const BENCH_DATA & data = bench_data();
+	if (data.corpus.empty())
+	{
+		state.SkipWithError("set SENTENCE_BREAKER_BENCH_CORPUS to a text file");
+		return;
+	}
+	break_sentence_pass(state, *data.dict, data.corpus, static_cast<SEGMENTATION_MODE>(state.range(0)));
+}
+BENCHMARK(BM_BreakSentence_Corpus)
+	->Arg(static_cast<int>(SEGMENTATION_MODE::GREEDY))
+	->Arg(static_cast<int>(SEGMENTATION_MODE::FEWEST_WORDS))
+	->Arg(static_cast<int>(SEGMENTATION_MODE::UNIGRAM_COST))
+	->Unit(benchmark::kMillisecond);
+
+// The lattice modes with and without match links, over the real corpus if set and the synthetic one otherwise.
+// Args: SEGMENTATION_MODE, 1 for match links
+void BM_BreakSentence_MatchLinks(benchmark::State & state)
+{
+	const BENCH_DATA & data = bench_data();
+	break_sentence_pass(state, state.range(1) != 0 ? *data.linked_dict : *data.dict,
+		data.corpus.empty() ? data.synthetic_corpus : data.corpus, static_cast<SEGMENTATION_MODE>(state.range(0)));
+}
+BENCHMARK(BM_BreakSentence_MatchLinks)
+	->Args({ static_cast<int>(SEGMENTATION_MODE::FEWEST_WORDS), 0 })
+	->Args({ static_cast<int>(SEGMENTATION_MODE::FEWEST_WORDS), 1 })
+	->Args({ static_cast<int>(SEGMENTATION_MODE::UNIGRAM_COST), 0 })
+	->Args({ static_cast<int>(SEGMENTATION_MODE::UNIGRAM_COST), 1 })
+	->Unit(benchmark::kMillisecond);
+
+// Args: k, 1 for match links. Words counted are those of all candidates.
+void BM_BreakSentence_NBest(benchmark::State & state)
+{
+	const DICTIONARY & dict = state.range(1) != 0 ? *bench_data().linked_dict : *bench_data().dict;
+	const std::vector<std::string> & tokens = bench_data().synthetic_corpus;
+	const std::size_t k = static_cast<std::size_t>(state.range(0));
+	std::vector<SEGMENTATION_CANDIDATE> candidates;
+	std::size_t num_words = 0, num_failed = 0;
+	for (auto _ : state)
+	{
+		for (const std::string & token : tokens)
+		{
+			if (break_sentence_n_best(candidates, token, dict, k).status != SEGMENTATION_STATUS::OK)
+			{
+				++num_failed;
+			}
+			for (const SEGMENTATION_CANDIDATE & candidate : candidates)
+			{
+				num_words += candidate.words.size();
+			}
+		}
+	}
+
+	const double passes = static_cast<double>(state.iterations());
+	set_rates(state, passes * static_cast<double>(total_length(tokens)), static_cast<double>(num_words));
+	state.counters["failed"] = static_cast<double>(num_failed) / passes;
+}
+BENCHMARK(BM_BreakSentence_NBest)->ArgsProduct({ { 1, 4, 16 }, { 0, 1 } })->Unit(benchmark::kMillisecond);
+
+// The synthetic corpus as one unspaced input, segmented by try_break_sentence_parallel. Arg: workers
+void BM_BreakSentence_LongInput(benchmark::State & state)
+{
+	const DICTIONARY & dict = *bench_data().dict;
+	std::string input;
+	for (const std::string & token : bench_data().synthetic_corpus)
+	{
+		input += token;
+	}
+	WORK_STEALING_POOL pool(static_cast<unsigned>(state.range(0)));
+	std::vector<WORD_SPAN> spans;
+	std::size_t num_words = 0;
+	for (auto _ : state)
+	{
+		try_break_sentence_parallel(spans, input.data(), input.size(), dict, pool);
+		num_words += spans.size();
+	}
+	set_rates(state, static_cast<double>(state.iterations()) * static_cast<double>(input.size()), static_cast<double>(num_words));
+}
+BENCHMARK(BM_BreakSentence_LongInput)->Arg(1)->Arg(2)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // End Anonymous Namespace
+
+BENCHMARK_MAIN();
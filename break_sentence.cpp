@@ -0,0 +1,765 @@
+#include "break_sentence.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include "normalize.hpp"
+#include "stats.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+namespace
+{
+
+// Path costs of the lattice engines, see break_sentence_lattice
+typedef std::uint64_t PATH_COST;
+const PATH_COST WORD_COST = 1;
+const unsigned UNKNOWN_SHIFT = 40;
+const PATH_COST UNKNOWN_CHAR_COST = PATH_COST(1) << UNKNOWN_SHIFT;
+static_assert((MAX_UNIGRAM_RUN - 1) * (WORD_COST + std::numeric_limits<DICTIONARY::COST>::max()) < UNKNOWN_CHAR_COST,
+	"word costs of a run under MAX_UNIGRAM_RUN must stay below the unknown code points");
+
+// One of the K best paths to a lattice vertex: its cost and the entry of the vertex its last edge starts from
+struct BEAM_ENTRY
+{
+	PATH_COST cost;
+	std::size_t previous_vertex;
+	std::size_t previous_rank;
+	bool unknown;                 // The last edge is an unknown character
+};
+
+// Scratch memory of the engines. One per thread, so the hot path stops allocating once it has seen its longest input.
+struct SCRATCH
+{
+	std::vector<char> folded;
+	std::vector<std::size_t> run_ends;
+	std::vector<std::uint64_t> best_cost;
+	std::vector<std::size_t> best_word_begin;
+	std::vector<WORD_SPAN> spans;
+	std::vector<BEAM_ENTRY> beams;        // K per vertex, best first
+	std::vector<std::size_t> beam_sizes;
+};
+
+SCRATCH & thread_scratch()
+{
+	static thread_local SCRATCH scratch;
+	return scratch;
+}
+
+// Beam entries a thread keeps between calls. A call that needs more gets them, and gives them back when it returns,
+// so one long input doesn't pin its lattice on the thread for good.
+const std::size_t BEAMS_HIGH_WATER = std::size_t(1) << 17;
+
+// Releases the beams of the thread's scratch on destruction, if the call grew them past BEAMS_HIGH_WATER
+class BEAMS_RELEASE
+{
+public:
+	explicit BEAMS_RELEASE(SCRATCH & scratch)
+	:
+		m_scratch(scratch)
+	{
+
+	}
+
+	BEAMS_RELEASE(const BEAMS_RELEASE &) = delete;
+	BEAMS_RELEASE & operator=(const BEAMS_RELEASE &) = delete;
+
+	~BEAMS_RELEASE()
+	{
+		if (m_scratch.beams.capacity() > BEAMS_HIGH_WATER)
+		{
+			std::vector<BEAM_ENTRY>().swap(m_scratch.beams);
+			std::vector<std::size_t>().swap(m_scratch.beam_sizes);
+		}
+	}
+
+private:
+	SCRATCH & m_scratch;
+};
+
+// First code point in [begin, end) at which some dictionary word starts, or end.
+// Used to find where a run of unknown letters ends.
+template <typename DICT>
+const char * next_word_begin(const char * begin, const char * end, const DICT & dict)
+{
+	auto cursor = dict.cursor();
+	for (const char * word_begin = begin; word_begin != end; word_begin += code_point_length(*word_begin))
+	{
+		cursor.reset();
+		for (const char * iter = word_begin; iter != end; ++iter)
+		{
+			bool is_word, is_prefix;
+			std::tie(is_word, is_prefix) = cursor.advance(*iter);
+			if (is_word)
+			{
+				return word_begin;
+			}
+			if (!is_prefix)
+			{
+				break;
+			}
+		}
+	}
+	return end;
+}
+
+// The engines below segment one run of folded letters, each appends its words to word_breakdown with offsets
+// relative to the whole input (`offset` is where the run starts in it). DICT is DICTIONARY or LAYERED_DICTIONARY,
+// anything with a cursor().
+//
+// The trie steps on UTF-8 bytes, but a run holds only valid UTF-8 and every dictionary word is a whole number of code
+// points, so any word found from a code point start ends on one too. Unknown words are whole code points as well,
+// which keeps every boundary the engines emit on a code point start.
+//
+// They return the length of the run when it is fully segmented. Otherwise (UNKNOWN_POLICY::FAIL only) they return
+// the position in the run where segmentation got stuck, with the partial segmentation appended.
+
+// Complexity:
+// Every character is fed to a DICTIONARY::CURSOR once per round, so there is no redundant re-walk of the current prefix.
+// O of input string length * one double-array step (constant)
+//   = linear, plus whatever is re-read after rolling back to the last exact match
+// Every step that keeps the round going goes one level deeper in the trie, so a round reads at most
+// dict.max_word_length() characters and rolls back fewer than that: on adversarial input (a long run that keeps
+// almost spelling a long word) the worst case is O(input string length * max_word_length), never quadratic.
+template <typename DICT>
+std::size_t break_sentence_greedy(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence, std::size_t length,
+	std::size_t offset, const DICT & dict, UNKNOWN_POLICY policy)
+{
+	// Robustness consideration (not all are implemented)
+	// 1) Spaces? Handled by main string reader already. But if still exists,
+	//    just jump over them and continue matching at next real character
+	// 2) Segments of non alphabetical? Consider as one word - split off by fold_and_classify before we get here
+	// 3) Cases? Preserve, the output spans point into the original input, only the folded copy is matched
+	// 4) What if it gets stuck? Report where to the caller, or emit an unknown word up to the next word start
+
+	// Iterator pairs for the whole input sentences
+	const char * const begin_iter = in_sentence;
+	const char * const end_iter   = in_sentence + length;
+
+	// Iterators that stores the progress of the current word being worked on.
+	// [round_begin, round_curr) is the prefix under test, and the cursor sits on its trie node.
+	const char * round_begin = begin_iter;
+	const char * round_curr = begin_iter;
+	auto cursor = dict.cursor();
+
+	// End of the longest match found so far for the current word being worked on.
+	// Words are never empty, so round_begin means no match yet.
+	const char * last_exact_match_end_iter = round_begin; // Always reset to round_begin when move on to a new word
+
+	// Unknown words have their own counter, the word histogram is of dictionary words only
+	auto emit = [&](const char * word_end, bool unknown)
+	{
+		if (!unknown)
+		{
+			SENTENCE_BREAKER_COUNT_WORD(static_cast<std::size_t>(word_end - round_begin));
+		}
+		word_breakdown.push_back(WORD_SPAN{ offset + static_cast<std::size_t>(round_begin - begin_iter),
+			static_cast<std::size_t>(word_end - round_begin), unknown });
+	};
+
+	// Loop to greedily find the longest match and add it to the result vector, then start at next character and repeat.
+	while (round_begin != end_iter)
+	{
+		// Running out of input is the same as hitting a character that no word continues with.
+		bool is_word = false, is_prefix = false;
+		if (round_curr != end_iter)
+		{
+			std::tie(is_word, is_prefix) = cursor.advance(*round_curr);
+			++round_curr;
+		}
+
+		if (is_word)
+		{
+			if (!is_prefix || (round_curr == end_iter))
+			{
+				// Perfect. This is the longest possible solution for the current word.
+				// There’s no chance that keep appending on the current word can give us a longer result.
+				// Action: Add the word to buffer and set up everything for a new round (new word).
+
+				emit(round_curr, false);
+				round_begin = round_curr;
+				cursor.reset();
+				last_exact_match_end_iter = round_begin;
+			}
+			else
+			{
+				// This is a good match, but there might be more possibilities if we appending to the word under test.
+				// Action: keep trying to match more characters, but save the char iterator just in case
+				// All subsequent matches fail - we’ll revert to this solution by then.
+				last_exact_match_end_iter = round_curr;
+			}
+
+		}
+		else // !is_word
+		{
+			if (is_prefix)
+			{
+				// Not a word, but could be part of a word.
+				// Still there’s chances to find a word if we keep appending new characters.
+				// Action: Stay in current round, the next advance expands the prefix under test.
+			}
+			else
+			{
+				// We failed by either overmatching (if last exact match was set), or by impossible input (if otherwise)
+				// Action:
+				// In case of overmatching, we just revert to the last matched word, and roll back iterators for new round.
+				// Otherwise, the policy decides: give up here, or skip to the next word start as one unknown word.
+				if (last_exact_match_end_iter == round_begin)
+				{
+					if (policy == UNKNOWN_POLICY::FAIL)
+					{
+						SENTENCE_BREAKER_COUNT(impossible_matches, 1);
+						return static_cast<std::size_t>(round_begin - begin_iter);
+					}
+
+					SENTENCE_BREAKER_COUNT(unknown_words, 1);
+					const char * const unknown_end = next_word_begin(round_begin + code_point_length(*round_begin), end_iter, dict);
+					emit(unknown_end, true);
+					round_begin = unknown_end;
+				}
+				else
+				{
+					SENTENCE_BREAKER_COUNT(rollbacks, 1);
+					SENTENCE_BREAKER_COUNT(rolled_back_chars, static_cast<std::size_t>(round_curr - last_exact_match_end_iter));
+					emit(last_exact_match_end_iter, false);
+					round_begin = last_exact_match_end_iter;
+				}
+				round_curr = round_begin;
+				cursor.reset();
+				last_exact_match_end_iter = round_begin;
+			}
+		} // end if-else (is_word)
+	}
+	return length;
+}
+
+// The lattice engines below find their edges in one of two ways. Without match links they push: a CURSOR walk from each
+// settled vertex relaxes the vertices its words end at. With them, scan_words pulls instead: one SCANNER pass reports
+// the words ending at each vertex (on_word(word_begin, word_end, cost), longest first) and, once the last byte of a
+// code point is in, calls on_end(code_point_begin, code_point_end), so a vertex has all its incoming edges before the
+// pass moves on. Both orders offer the edges into a vertex by ascending start, so ties break the same way and the
+// results are identical.
+//
+// Returns false, without calling anything, when the dictionary has no match links.
+template <typename DICT, typename ON_WORD, typename ON_END>
+bool scan_words(const DICT &, const char *, std::size_t, std::size_t, ON_WORD, ON_END)
+{
+	return false;
+}
+
+template <typename ON_WORD, typename ON_END>
+bool scan_words(const DICTIONARY & dict, const char * text, std::size_t begin, std::size_t end, ON_WORD on_word,
+	ON_END on_end)
+{
+	if (!dict.has_match_links())
+	{
+		return false;
+	}
+
+	auto scanner = dict.scanner();
+	std::size_t code_point_begin = begin;
+	for (std::size_t word_end = begin + 1; word_end <= end; ++word_end)
+	{
+		scanner.advance(text[word_end - 1]);
+		scanner.for_each_word([&](std::size_t length, DICTIONARY::COST cost)
+		{
+			on_word(word_end - length, word_end, cost);
+		});
+		if (word_end == end || !is_continuation(text[word_end]))
+		{
+			on_end(code_point_begin, word_end);
+			code_point_begin = word_end;
+		}
+	}
+	return true;
+}
+
+// Optimal segmentation over the word lattice (Viterbi).
+//
+// The lattice has one vertex per position in the input and one edge [i, j) per dictionary word in_sentence[i, j).
+// A single forward pass settles the vertices left to right: a vertex is final once every vertex before it has been
+// expanded, so best_cost[i] is known when the cursor starts its walk from i, and every word found on that walk relaxes
+// the vertex it ends at. The walk stops as soon as the prefix leaves the trie, so no edge is ever looked for twice.
+//
+// Cost of a path is its number of words in FEWEST_WORDS mode, and the sum of its words' DICTIONARY::COST plus its number
+// of words in UNIGRAM_COST mode, so equally likely splits still go to the one with fewer words. Ties keep the first path
+// found, which is the one whose last word is longest.
+//
+// With UNKNOWN_POLICY::EMIT_UNKNOWN every code point also gets a penalty edge over its bytes. Its cost lives in the
+// bits above UNKNOWN_SHIFT, so paths compare by unknown code points first and by words second, and consecutive penalty
+// edges of the best path come out as one unknown word. Word costs stay below that as long as a run is under
+// MAX_UNIGRAM_RUN bytes, a longer one throws std::length_error. Without EMIT_UNKNOWN nothing lives up there, and no edge
+// is taken for unknown however far the word costs reach.
+//
+// Complexity: O(input string length * max_word_length()) time, since a walk never outlasts the trie's height, and
+// O(input string length) space. With match links O(input string length + words found) trie steps.
+template <typename DICT>
+std::size_t break_sentence_lattice(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence, std::size_t length,
+	std::size_t offset, const DICT & dict, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	typedef PATH_COST COST;
+	const COST UNREACHABLE = std::numeric_limits<COST>::max();
+	const bool by_frequency = mode == SEGMENTATION_MODE::UNIGRAM_COST;
+	if (by_frequency && policy == UNKNOWN_POLICY::EMIT_UNKNOWN && length >= MAX_UNIGRAM_RUN)
+	{
+		throw std::length_error("break_sentence: run of letters over MAX_UNIGRAM_RUN in UNIGRAM_COST mode");
+	}
+
+	SCRATCH & scratch = thread_scratch();
+	std::vector<COST> & best_cost = scratch.best_cost;
+	std::vector<std::size_t> & best_word_begin = scratch.best_word_begin;  // Back pointer: where the last word of the best path starts
+	best_cost.assign(length + 1, UNREACHABLE);
+	best_word_begin.resize(length + 1);
+	best_cost[0] = 0;
+
+	std::size_t reached = 0;  // Furthest vertex with a path, where the best prefix split ends on failure
+	auto relax = [&](std::size_t word_begin, std::size_t word_end, COST cost)
+	{
+		if (cost < best_cost[word_end])
+		{
+			best_cost[word_end] = cost;
+			best_word_begin[word_end] = word_begin;
+		}
+	};
+	auto relax_unknown = [&](std::size_t word_begin, std::size_t word_end)
+	{
+		if (policy == UNKNOWN_POLICY::EMIT_UNKNOWN)
+		{
+			relax(word_begin, word_end, best_cost[word_begin] + UNKNOWN_CHAR_COST);
+		}
+	};
+
+	const bool scanned = scan_words(dict, in_sentence, 0, length,
+		[&](std::size_t word_begin, std::size_t word_end, DICTIONARY::COST word_cost)
+		{
+			if (best_cost[word_begin] != UNREACHABLE)
+			{
+				relax(word_begin, word_end, best_cost[word_begin] + (by_frequency ? WORD_COST + word_cost : WORD_COST));
+			}
+		},
+		[&](std::size_t code_point_begin, std::size_t code_point_end)
+		{
+			if (best_cost[code_point_begin] != UNREACHABLE)
+			{
+				reached = code_point_begin;
+				relax_unknown(code_point_begin, code_point_end);
+			}
+		});
+
+	auto cursor = dict.cursor();
+	for (std::size_t word_begin = 0; !scanned && word_begin < length; ++word_begin)
+	{
+		if (best_cost[word_begin] == UNREACHABLE)
+		{
+			continue;
+		}
+		reached = word_begin;
+
+		cursor.reset();
+		const COST begin_cost = best_cost[word_begin] + WORD_COST;
+		for (std::size_t word_end = word_begin; word_end < length; )
+		{
+			bool is_word, is_prefix;
+			std::tie(is_word, is_prefix) = cursor.advance(in_sentence[word_end]);
+			++word_end;
+
+			if (is_word)
+			{
+				relax(word_begin, word_end, by_frequency ? begin_cost + cursor.cost() : begin_cost);
+			}
+			if (!is_prefix)
+			{
+				break;
+			}
+		}
+		relax_unknown(word_begin, word_begin + code_point_length(in_sentence[word_begin]));
+	}
+
+	std::size_t end = length;
+	if (best_cost[length] == UNREACHABLE)
+	{
+		SENTENCE_BREAKER_COUNT(impossible_matches, 1);
+		end = reached;
+	}
+
+	auto is_unknown_edge = [&](std::size_t word_begin, std::size_t word_end)
+	{
+		return policy == UNKNOWN_POLICY::EMIT_UNKNOWN
+			&& (best_cost[word_begin] >> UNKNOWN_SHIFT) != (best_cost[word_end] >> UNKNOWN_SHIFT);
+	};
+
+	// Follow the back pointers from the end, then put the words in reading order
+	const std::size_t first_word = word_breakdown.size();
+	for (std::size_t word_end = end; word_end != 0; )
+	{
+		std::size_t word_begin = best_word_begin[word_end];
+		const bool unknown = is_unknown_edge(word_begin, word_end);
+		if (unknown)
+		{
+			while (word_begin != 0 && is_unknown_edge(best_word_begin[word_begin], word_begin))
+			{
+				word_begin = best_word_begin[word_begin];
+			}
+			SENTENCE_BREAKER_COUNT(unknown_words, 1);
+		}
+		else
+		{
+			SENTENCE_BREAKER_COUNT_WORD(word_end - word_begin);
+		}
+		word_breakdown.push_back(WORD_SPAN{ offset + word_begin, word_end - word_begin, unknown });
+		word_end = word_begin;
+	}
+	std::reverse(word_breakdown.begin() + static_cast<std::ptrdiff_t>(first_word), word_breakdown.end());
+	return end;
+}
+
+// Every run of non-letters is one word, only the runs of letters go to the engine.
+template <typename DICT>
+SEGMENTATION_RESULT segment(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence, std::size_t length,
+	const DICT & dict, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	word_breakdown.clear();
+	SENTENCE_BREAKER_COUNT(calls, 1);
+	SENTENCE_BREAKER_COUNT(characters, length);
+
+	SCRATCH & scratch = thread_scratch();
+	scratch.folded.resize(length);
+	bool is_alpha_run = fold_and_classify(in_sentence, length, scratch.folded.data(), scratch.run_ends);
+
+	SEGMENTATION_RESULT result = { SEGMENTATION_STATUS::OK, length, 0 };
+	std::size_t run_begin = 0;
+	for (const std::size_t run_end : scratch.run_ends)
+	{
+		const char * const run = scratch.folded.data() + run_begin;
+		const std::size_t run_length = run_end - run_begin;
+		std::size_t segmented = run_length;
+		if (!is_alpha_run)
+		{
+			word_breakdown.push_back(WORD_SPAN{ run_begin, run_length, false });
+		}
+		else if (mode == SEGMENTATION_MODE::GREEDY)
+		{
+			segmented = break_sentence_greedy(word_breakdown, run, run_length, run_begin, dict, policy);
+		}
+		else
+		{
+			segmented = break_sentence_lattice(word_breakdown, run, run_length, run_begin, dict, mode, policy);
+		}
+
+		if (segmented != run_length)
+		{
+			result.status = SEGMENTATION_STATUS::IMPOSSIBLE_MATCH;
+			result.failure_offset = run_begin + segmented;
+			break;
+		}
+		is_alpha_run = !is_alpha_run;
+		run_begin = run_end;
+	}
+
+	if (policy == UNKNOWN_POLICY::EMIT_UNKNOWN)
+	{
+		for (const WORD_SPAN & span : word_breakdown)
+		{
+			result.num_unknown += span.unknown ? 1 : 0;
+		}
+	}
+	return result;
+}
+
+// Inserts entry into a beam sorted by cost that holds at most k entries, dropping the worst one when it is full.
+// Returns false when entry is no better than all k, so neither is anything costlier.
+bool beam_insert(BEAM_ENTRY * beam, std::size_t & size, std::size_t k, const BEAM_ENTRY & entry)
+{
+	if (size == k && !(entry.cost < beam[k - 1].cost))
+	{
+		return false;
+	}
+	std::size_t pos = size < k ? size++ : k - 1;
+	for (; pos != 0 && entry.cost < beam[pos - 1].cost; --pos)
+	{
+		beam[pos] = beam[pos - 1];
+	}
+	beam[pos] = entry;
+	return true;
+}
+
+// K best segmentations over the word lattice of break_sentence_lattice, in one forward pass.
+//
+// Every vertex keeps a beam of its k cheapest paths instead of one, each entry pointing at the beam entry its last
+// edge extends. Relaxing an edge [i, j) merges beam i, shifted by the edge's cost, into beam j; beam i is sorted, so
+// the merge stops at the first entry that doesn't make it. The candidates are then read back from the beam of the
+// last vertex, so all k share the one pass and the one walk per position over the trie.
+//
+// Unlike segment(), the lattice spans the whole token: a run of non-letters is one free edge, and words don't cross
+// from one run of letters into the next one.
+//
+// Complexity: O(input string length * max_word_length() * k) time and O(input string length * k) space.
+// Match links bring the trie steps down to O(input string length + words found), as in break_sentence_lattice.
+template <typename DICT>
+SEGMENTATION_RESULT segment_n_best(std::vector<SEGMENTATION_CANDIDATE> & candidates, const char * in_sentence,
+	std::size_t length, const DICT & dict, std::size_t k, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	SENTENCE_BREAKER_COUNT(calls, 1);
+	SENTENCE_BREAKER_COUNT(characters, length);
+
+	if (k > MAX_N_BEST)
+	{
+		throw std::invalid_argument("break_sentence_n_best: k must not be over MAX_N_BEST");
+	}
+	if (k != 0 && length >= MAX_N_BEST_ENTRIES / k)
+	{
+		throw std::length_error("break_sentence_n_best: (length + 1) * k over MAX_N_BEST_ENTRIES");
+	}
+	// So no run can get to MAX_UNIGRAM_RUN either, and candidate costs never reach the unknown code points
+	static_assert(MAX_N_BEST_ENTRIES <= MAX_UNIGRAM_RUN, "an n-best lattice must fit the unigram path costs");
+
+	SEGMENTATION_RESULT result = { SEGMENTATION_STATUS::OK, length, 0 };
+	if (k == 0)
+	{
+		candidates.clear();
+		return result;
+	}
+
+	SCRATCH & scratch = thread_scratch();
+	const BEAMS_RELEASE release(scratch);
+	scratch.folded.resize(length);
+	bool is_alpha_run = fold_and_classify(in_sentence, length, scratch.folded.data(), scratch.run_ends);
+	const char * const folded = scratch.folded.data();
+
+	std::vector<BEAM_ENTRY> & beams = scratch.beams;
+	std::vector<std::size_t> & beam_sizes = scratch.beam_sizes;
+	beams.resize((length + 1) * k);
+	beam_sizes.assign(length + 1, 0);
+	beams[0] = BEAM_ENTRY{ 0, 0, 0, false };
+	beam_sizes[0] = 1;
+
+	const bool by_frequency = mode == SEGMENTATION_MODE::UNIGRAM_COST;
+	auto relax = [&](std::size_t word_begin, std::size_t word_end, PATH_COST edge_cost, bool unknown)
+	{
+		const BEAM_ENTRY * const from = &beams[word_begin * k];
+		for (std::size_t rank = 0; rank < beam_sizes[word_begin]; ++rank)
+		{
+			if (!beam_insert(&beams[word_end * k], beam_sizes[word_end], k,
+				BEAM_ENTRY{ from[rank].cost + edge_cost, word_begin, rank, unknown }))
+			{
+				break;
+			}
+		}
+	};
+
+	std::size_t reached = 0;
+	std::size_t run_begin = 0;
+	auto cursor = dict.cursor();
+	for (const std::size_t run_end : scratch.run_ends)
+	{
+		if (!is_alpha_run)
+		{
+			if (beam_sizes[run_begin] != 0)
+			{
+				reached = run_begin;
+				relax(run_begin, run_end, 0, false);
+			}
+		}
+		else if (!scan_words(dict, folded, run_begin, run_end,
+			[&](std::size_t word_begin, std::size_t word_end, DICTIONARY::COST word_cost)
+			{
+				relax(word_begin, word_end, by_frequency ? WORD_COST + word_cost : WORD_COST, false);
+			},
+			[&](std::size_t code_point_begin, std::size_t code_point_end)
+			{
+				if (beam_sizes[code_point_begin] != 0)
+				{
+					reached = code_point_begin;
+					if (policy == UNKNOWN_POLICY::EMIT_UNKNOWN)
+					{
+						relax(code_point_begin, code_point_end, UNKNOWN_CHAR_COST, true);
+					}
+				}
+			}))
+		{
+			for (std::size_t word_begin = run_begin; word_begin < run_end; ++word_begin)
+			{
+				if (beam_sizes[word_begin] == 0)
+				{
+					continue;
+				}
+				reached = word_begin;
+
+				cursor.reset();
+				for (std::size_t word_end = word_begin; word_end < run_end; )
+				{
+					bool is_word, is_prefix;
+					std::tie(is_word, is_prefix) = cursor.advance(folded[word_end]);
+					++word_end;
+
+					if (is_word)
+					{
+						relax(word_begin, word_end, by_frequency ? WORD_COST + cursor.cost() : WORD_COST, false);
+					}
+					if (!is_prefix)
+					{
+						break;
+					}
+				}
+
+				if (policy == UNKNOWN_POLICY::EMIT_UNKNOWN)
+				{
+					relax(word_begin, word_begin + code_point_length(folded[word_begin]), UNKNOWN_CHAR_COST, true);
+				}
+			}
+		}
+		is_alpha_run = !is_alpha_run;
+		run_begin = run_end;
+	}
+
+	if (beam_sizes[length] == 0)
+	{
+		SENTENCE_BREAKER_COUNT(impossible_matches, 1);
+		candidates.clear();
+		result.status = SEGMENTATION_STATUS::IMPOSSIBLE_MATCH;
+		result.failure_offset = reached;
+		return result;
+	}
+
+	// Follow the back pointers of every entry of the last beam, consecutive unknown characters make one unknown word
+	candidates.resize(beam_sizes[length]);
+	for (std::size_t candidate = 0; candidate < candidates.size(); ++candidate)
+	{
+		const BEAM_ENTRY & last = beams[length * k + candidate];
+		SEGMENTATION_CANDIDATE & out = candidates[candidate];
+		out.words.clear();
+		out.cost = last.cost & (UNKNOWN_CHAR_COST - 1);
+		out.unknown_characters = static_cast<std::size_t>(last.cost >> UNKNOWN_SHIFT);
+		out.num_unknown = 0;
+
+		std::size_t vertex = length, rank = candidate;
+		while (vertex != 0)
+		{
+			const std::size_t word_end = vertex;
+			const bool unknown = beams[vertex * k + rank].unknown;
+			do
+			{
+				const BEAM_ENTRY & entry = beams[vertex * k + rank];
+				vertex = entry.previous_vertex;
+				rank = entry.previous_rank;
+			} while (unknown && vertex != 0 && beams[vertex * k + rank].unknown);
+
+			out.num_unknown += unknown ? 1 : 0;
+			out.words.push_back(WORD_SPAN{ vertex, word_end - vertex, unknown });
+		}
+		std::reverse(out.words.begin(), out.words.end());
+	}
+	result.num_unknown = candidates.front().num_unknown;
+	return result;
+}
+
+template <typename DICT>
+void copy_words(std::vector<std::string> & word_breakdown, const std::string & in_sentence, const DICT & dict,
+	SEGMENTATION_MODE mode)
+{
+	std::vector<WORD_SPAN> & spans = thread_scratch().spans;
+	break_sentence(spans, in_sentence, dict, mode);
+
+	word_breakdown.clear();
+	for (const WORD_SPAN & span : spans)
+	{
+		word_breakdown.emplace_back(in_sentence, span.offset, span.length);
+	}
+}
+
+} // End Anonymous Namespace
+
+SEGMENTATION_RESULT try_break_sentence(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence,
+	std::size_t length, const DICTIONARY & dict, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	return segment(word_breakdown, in_sentence, length, dict, mode, policy);
+}
+
+SEGMENTATION_RESULT try_break_sentence(std::vector<WORD_SPAN> & word_breakdown, const std::string & in_sentence,
+	const DICTIONARY & dict, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	return segment(word_breakdown, in_sentence.data(), in_sentence.size(), dict, mode, policy);
+}
+
+void break_sentence(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence, std::size_t length,
+	const DICTIONARY & dict, SEGMENTATION_MODE mode)
+{
+	if (segment(word_breakdown, in_sentence, length, dict, mode, UNKNOWN_POLICY::FAIL).status != SEGMENTATION_STATUS::OK)
+	{
+		throw EXCEPTIONS::IMPOSSIBLE_MATCH_EXCEPTION();
+	}
+}
+
+void break_sentence(std::vector<WORD_SPAN> & word_breakdown, const std::string & in_sentence, const DICTIONARY & dict,
+	SEGMENTATION_MODE mode)
+{
+	break_sentence(word_breakdown, in_sentence.data(), in_sentence.size(), dict, mode);
+}
+
+void break_sentence(std::vector<std::string> & word_breakdown, const std::string & in_sentence, const DICTIONARY & dict,
+	SEGMENTATION_MODE mode)
+{
+	copy_words(word_breakdown, in_sentence, dict, mode);
+}
+
+SEGMENTATION_RESULT break_sentence_n_best(std::vector<SEGMENTATION_CANDIDATE> & candidates, const char * in_sentence,
+	std::size_t length, const DICTIONARY & dict, std::size_t k, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	return segment_n_best(candidates, in_sentence, length, dict, k, mode, policy);
+}
+
+SEGMENTATION_RESULT break_sentence_n_best(std::vector<SEGMENTATION_CANDIDATE> & candidates, const std::string & in_sentence,
+	const DICTIONARY & dict, std::size_t k, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	return segment_n_best(candidates, in_sentence.data(), in_sentence.size(), dict, k, mode, policy);
+}
+
+SEGMENTATION_RESULT try_break_sentence(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence,
+	std::size_t length, const LAYERED_DICTIONARY & dict, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	return segment(word_breakdown, in_sentence, length, dict, mode, policy);
+}
+
+SEGMENTATION_RESULT try_break_sentence(std::vector<WORD_SPAN> & word_breakdown, const std::string & in_sentence,
+	const LAYERED_DICTIONARY & dict, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	return segment(word_breakdown, in_sentence.data(), in_sentence.size(), dict, mode, policy);
+}
+
+void break_sentence(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence, std::size_t length,
+	const LAYERED_DICTIONARY & dict, SEGMENTATION_MODE mode)
+{
+	if (segment(word_breakdown, in_sentence, length, dict, mode, UNKNOWN_POLICY::FAIL).status != SEGMENTATION_STATUS::OK)
+	{
+		throw EXCEPTIONS::IMPOSSIBLE_MATCH_EXCEPTION();
+	}
+}
+
+void break_sentence(std::vector<WORD_SPAN> & word_breakdown, const std::string & in_sentence, const LAYERED_DICTIONARY & dict,
+	SEGMENTATION_MODE mode)
+{
+	break_sentence(word_breakdown, in_sentence.data(), in_sentence.size(), dict, mode);
+}
+
+void break_sentence(std::vector<std::string> & word_breakdown, const std::string & in_sentence, const LAYERED_DICTIONARY & dict,
+	SEGMENTATION_MODE mode)
+{
+	copy_words(word_breakdown, in_sentence, dict, mode);
+}
+
+SEGMENTATION_RESULT break_sentence_n_best(std::vector<SEGMENTATION_CANDIDATE> & candidates, const char * in_sentence,
+	std::size_t length, const LAYERED_DICTIONARY & dict, std::size_t k, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	return segment_n_best(candidates, in_sentence, length, dict, k, mode, policy);
+}
+
+SEGMENTATION_RESULT break_sentence_n_best(std::vector<SEGMENTATION_CANDIDATE> & candidates, const std::string & in_sentence,
+	const LAYERED_DICTIONARY & dict, std::size_t k, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	return segment_n_best(candidates, in_sentence.data(), in_sentence.size(), dict, k, mode, policy);
+}
+
+} // End Namespace
@@ -0,0 +1,142 @@
+#ifndef SENTENCE_BREAKER_BREAK_SENTENCE_HPP
+#define SENTENCE_BREAKER_BREAK_SENTENCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "dictionary.hpp"
+#include "exceptions.hpp"
+#include "layered_dictionary.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+// Segmentation engines, selectable per call
+enum class SEGMENTATION_MODE
+{
+	GREEDY,       // Longest match first. Fastest, but a long match can strand the rest of the input.
+	FEWEST_WORDS, // Optimal split over the word lattice, fails only if no split exists at all.
+	UNIGRAM_COST  // Same lattice, but the split of lowest total word cost (DICTIONARY::COST) wins, i.e. the most likely one.
+};
+
+// What the engines do with a run of letters that no dictionary word covers
+enum class UNKNOWN_POLICY
+{
+	FAIL,          // Stop there and report where, see SEGMENTATION_RESULT
+	EMIT_UNKNOWN   // Emit the shortest such run as one word flagged unknown, and carry on after it
+};
+
+// One word of a segmentation, as a position in the input
+struct WORD_SPAN
+{
+	std::size_t offset;
+	std::size_t length;
+	bool unknown;        // Not a dictionary word, only with UNKNOWN_POLICY::EMIT_UNKNOWN
+};
+
+enum class SEGMENTATION_STATUS
+{
+	OK,
+	IMPOSSIBLE_MATCH   // The engine found no split, word_breakdown holds the words up to failure_offset
+};
+
+struct SEGMENTATION_RESULT
+{
+	SEGMENTATION_STATUS status;
+	std::size_t failure_offset;  // Where segmentation got stuck, the input length on success
+	std::size_t num_unknown;     // Words flagged unknown
+};
+
+// One of the segmentations returned by break_sentence_n_best
+struct SEGMENTATION_CANDIDATE
+{
+	std::vector<WORD_SPAN> words;
+	std::uint64_t cost;              // Number of words, or their total DICTIONARY::COST plus that in UNIGRAM_COST mode
+	std::size_t unknown_characters;  // Code points in unknown words, which rank before cost
+	std::size_t num_unknown;         // Words flagged unknown
+};
+
+// UNIGRAM_COST with EMIT_UNKNOWN keeps a path's word costs and its unknown code points in one 64 bit number, which has
+// room for the word costs of a run of letters under MAX_UNIGRAM_RUN bytes. Every entry point, try_break_sentence too,
+// throws std::length_error on a longer run in that combination.
+constexpr std::size_t MAX_UNIGRAM_RUN = std::size_t(1) << 24;
+
+// Non throwing break_sentence, for inputs where failing is common (typos, names, URLs) and an exception per failure
+// would cost more than the segmentation itself.
+//
+// On failure word_breakdown keeps the partial segmentation: the greedy engine's words before the position it got
+// stuck at, the lattice engine's best split of the longest segmentable prefix. With EMIT_UNKNOWN it never fails.
+SEGMENTATION_RESULT try_break_sentence(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence,
+	std::size_t length, const DICTIONARY & dict, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY,
+	UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+SEGMENTATION_RESULT try_break_sentence(std::vector<WORD_SPAN> & word_breakdown, const std::string & in_sentence,
+	const DICTIONARY & dict, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY,
+	UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+// Splits in_sentence into dictionary words, see break_sentence.cpp for the engines.
+// Throws EXCEPTIONS::IMPOSSIBLE_MATCH_EXCEPTION when the engine finds no split.
+//
+// The span overloads are the allocation free hot path: the words are written as positions into the caller's input,
+// word_breakdown is cleared but keeps its capacity, and the engines' scratch memory is per thread and reused. Once
+// both have grown to the longest input seen, a call does no heap allocation at all.
+void break_sentence(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence, std::size_t length,
+	const DICTIONARY & dict, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY);
+
+void break_sentence(std::vector<WORD_SPAN> & word_breakdown, const std::string & in_sentence, const DICTIONARY & dict,
+	SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY);
+
+// Copies every word out of the input, for callers that need to own them.
+void break_sentence(std::vector<std::string> & word_breakdown, const std::string & in_sentence, const DICTIONARY & dict,
+	SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY);
+
+// Up to k best segmentations of in_sentence, best first, from one pass over the word lattice (see break_sentence.cpp).
+// Candidates rank by unknown characters, then by cost; mode picks the cost, GREEDY counts words like FEWEST_WORDS.
+//
+// Returns the status of the best candidate. On IMPOSSIBLE_MATCH candidates is empty and failure_offset is the end of
+// the longest segmentable prefix. candidates and its word vectors keep their capacity from call to call.
+//
+// The lattice holds k entries of 32 bytes per input byte, so both are bounded: throws std::invalid_argument when k
+// is over MAX_N_BEST, and std::length_error when (length + 1) * k is over MAX_N_BEST_ENTRIES (128 MiB of entries, an
+// input of 4095 bytes at the largest k). Scratch grown past a few MiB is given back when the call returns.
+constexpr std::size_t MAX_N_BEST = 1024;
+constexpr std::size_t MAX_N_BEST_ENTRIES = std::size_t(1) << 22;
+
+SEGMENTATION_RESULT break_sentence_n_best(std::vector<SEGMENTATION_CANDIDATE> & candidates, const char * in_sentence,
+	std::size_t length, const DICTIONARY & dict, std::size_t k,
+	SEGMENTATION_MODE mode = SEGMENTATION_MODE::FEWEST_WORDS, UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+SEGMENTATION_RESULT break_sentence_n_best(std::vector<SEGMENTATION_CANDIDATE> & candidates, const std::string & in_sentence,
+	const DICTIONARY & dict, std::size_t k,
+	SEGMENTATION_MODE mode = SEGMENTATION_MODE::FEWEST_WORDS, UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+// The same over the union of several dictionaries, see LAYERED_DICTIONARY
+SEGMENTATION_RESULT try_break_sentence(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence,
+	std::size_t length, const LAYERED_DICTIONARY & dict, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY,
+	UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+SEGMENTATION_RESULT try_break_sentence(std::vector<WORD_SPAN> & word_breakdown, const std::string & in_sentence,
+	const LAYERED_DICTIONARY & dict, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY,
+	UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+void break_sentence(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence, std::size_t length,
+	const LAYERED_DICTIONARY & dict, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY);
+
+void break_sentence(std::vector<WORD_SPAN> & word_breakdown, const std::string & in_sentence,
+	const LAYERED_DICTIONARY & dict, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY);
+
+void break_sentence(std::vector<std::string> & word_breakdown, const std::string & in_sentence,
+	const LAYERED_DICTIONARY & dict, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY);
+
+SEGMENTATION_RESULT break_sentence_n_best(std::vector<SEGMENTATION_CANDIDATE> & candidates, const char * in_sentence,
+	std::size_t length, const LAYERED_DICTIONARY & dict, std::size_t k,
+	SEGMENTATION_MODE mode = SEGMENTATION_MODE::FEWEST_WORDS, UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+SEGMENTATION_RESULT break_sentence_n_best(std::vector<SEGMENTATION_CANDIDATE> & candidates, const std::string & in_sentence,
+	const LAYERED_DICTIONARY & dict, std::size_t k,
+	SEGMENTATION_MODE mode = SEGMENTATION_MODE::FEWEST_WORDS, UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+} // End Namespace
+
+#endif
@@ -0,0 +1,236 @@
+#include "break_sentences.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+#include "normalize.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+namespace
+{
+
+const std::size_t NO_CUT = std::numeric_limits<std::size_t>::max();
+
+// First position in [nominal, nominal + overlap] that try_break_sentence_parallel may cut at, or NO_CUT.
+// letter_cut tells whether it lies inside a run of letters rather than on a run border.
+//
+// reach, the furthest end of a word starting in [window_begin, p), grows by one trie walk per position. No word is
+// longer than dict.max_word_length(), so starting the walks that far before nominal and reading that far past the
+// window makes reach exact, whatever the words are. A walk stops early once its cursor's completion says that no word
+// it could still find ends past reach.
+//
+// The window is folded and classified the way segment() sees it. Its ends are moved off continuation bytes first:
+// a byte that isn't one always starts a code point, however the text before it decodes, so the classes match.
+// Cuts only go on code point starts.
+std::size_t find_cut(const char * in_sentence, std::size_t length, std::size_t nominal, std::size_t overlap,
+	const DICTIONARY & dict, bool allow_letter_cuts, bool & letter_cut)
+{
+	const std::size_t max_word_length = dict.max_word_length();
+	std::size_t window_begin = nominal > max_word_length ? nominal - max_word_length : 0;
+	while (window_begin > 0 && is_continuation(in_sentence[window_begin]))
+	{
+		--window_begin;
+	}
+	const std::size_t window_end = std::min(length - 1, nominal + overlap);
+	std::size_t walk_end = std::min(length, window_end + max_word_length);
+	while (walk_end < length && is_continuation(in_sentence[walk_end]))
+	{
+		++walk_end;
+	}
+
+	// folded[i] and letter[i] are of in_sentence[window_begin + i]
+	std::vector<char> folded(walk_end - window_begin);
+	std::vector<std::size_t> run_ends;
+	bool is_alpha_run = fold_and_classify(in_sentence + window_begin, folded.size(), folded.data(), run_ends);
+	std::vector<bool> letter(folded.size());
+	std::size_t run_begin = 0;
+	for (const std::size_t run_end : run_ends)
+	{
+		std::fill(letter.begin() + static_cast<std::ptrdiff_t>(run_begin), letter.begin() + static_cast<std::ptrdiff_t>(run_end),
+			is_alpha_run);
+		is_alpha_run = !is_alpha_run;
+		run_begin = run_end;
+	}
+	auto is_letter = [&](std::size_t position)
+	{
+		return letter[position - window_begin];
+	};
+
+	std::size_t reach = window_begin;
+	auto cursor = dict.cursor();
+	for (std::size_t position = window_begin + 1; position <= window_end; ++position)
+	{
+		const std::size_t word_begin = position - 1;
+		if (allow_letter_cuts && is_letter(word_begin) && !is_continuation(in_sentence[word_begin]))
+		{
+			cursor.reset();
+			// A walk only gets to walk_end at the end of the input, which no word runs past either
+			for (std::size_t word_end = word_begin; word_end != walk_end && is_letter(word_end); )
+			{
+				bool is_word, is_prefix;
+				std::tie(is_word, is_prefix) = cursor.advance(folded[word_end - window_begin]);
+				++word_end;
+				if (is_word)
+				{
+					reach = std::max(reach, word_end);
+				}
+				const unsigned completion = cursor.completion();
+				if (!is_prefix || (completion < DICTIONARY::COMPLETION_LIMIT && word_end + completion <= reach))
+				{
+					break;
+				}
+			}
+		}
+
+		if (position < nominal || is_continuation(in_sentence[position]))
+		{
+			continue;
+		}
+		const bool alpha_before = is_letter(position - 1);
+		const bool alpha_after = is_letter(position);
+		if (alpha_before != alpha_after)
+		{
+			letter_cut = false;
+			return position;
+		}
+		if (allow_letter_cuts && alpha_after && reach <= position)
+		{
+			letter_cut = true;
+			return position;
+		}
+	}
+	return NO_CUT;
+}
+
+} // End Anonymous Namespace
+
+void break_sentences(const std::vector<std::string> & batch_in, BATCH_RESULT & batch_out, const DICTIONARY & dict,
+	WORK_STEALING_POOL & pool, SEGMENTATION_MODE mode)
+{
+	batch_out.m_entries.resize(batch_in.size());
+	batch_out.m_worker_words.resize(pool.num_workers());
+	batch_out.m_worker_scratch.resize(pool.num_workers());
+	for (auto & words : batch_out.m_worker_words)
+	{
+		words.clear();
+	}
+
+	pool.run(batch_in.size(), [&](std::size_t index, unsigned worker)
+	{
+		std::vector<WORD_SPAN> & scratch = batch_out.m_worker_scratch[worker];
+		std::vector<WORD_SPAN> & words = batch_out.m_worker_words[worker];
+
+		break_sentence(scratch, batch_in[index], dict, mode);
+
+		BATCH_RESULT::ENTRY & entry = batch_out.m_entries[index];
+		entry.worker = worker;
+		entry.first_word = words.size();
+		entry.num_words = scratch.size();
+		words.insert(words.end(), scratch.begin(), scratch.end());
+	});
+}
+
+void break_sentences(const std::vector<std::string> & batch_in, BATCH_RESULT & batch_out, const DICTIONARY & dict,
+	unsigned n_threads, SEGMENTATION_MODE mode)
+{
+	WORK_STEALING_POOL pool(n_threads);
+	break_sentences(batch_in, batch_out, dict, pool, mode);
+}
+
+void break_sentences(const std::vector<std::string> & batch_in, std::vector<std::vector<std::string>> & batch_out,
+	const DICTIONARY & dict, unsigned n_threads, SEGMENTATION_MODE mode)
+{
+	BATCH_RESULT result;
+	break_sentences(batch_in, result, dict, n_threads, mode);
+
+	batch_out.resize(batch_in.size());
+	for (std::size_t index = 0; index < batch_in.size(); ++index)
+	{
+		batch_out[index].clear();
+		for (const WORD_SPAN * word = result.words_begin(index); word != result.words_end(index); ++word)
+		{
+			batch_out[index].emplace_back(batch_in[index], word->offset, word->length);
+		}
+	}
+}
+
+SEGMENTATION_RESULT try_break_sentence_parallel(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence,
+	std::size_t length, const DICTIONARY & dict, WORK_STEALING_POOL & pool, SEGMENTATION_MODE mode,
+	UNKNOWN_POLICY policy, std::size_t chunk_size, std::size_t overlap)
+{
+	if (chunk_size == 0)
+	{
+		throw std::invalid_argument("try_break_sentence_parallel: chunk_size must not be 0");
+	}
+	if (length <= chunk_size)
+	{
+		return try_break_sentence(word_breakdown, in_sentence, length, dict, mode, policy);
+	}
+
+	// [cuts[i], cuts[i + 1]) is chunk i, letter_cuts[i] whether cuts[i] is inside a run of letters
+	const bool allow_letter_cuts = !(mode == SEGMENTATION_MODE::GREEDY && policy == UNKNOWN_POLICY::EMIT_UNKNOWN);
+	std::vector<std::size_t> cuts(1, 0);
+	std::vector<bool> letter_cuts(1, false);
+	for (std::size_t nominal = chunk_size; nominal < length; )
+	{
+		bool letter_cut = false;
+		const std::size_t cut = find_cut(in_sentence, length, nominal, overlap, dict, allow_letter_cuts, letter_cut);
+		if (cut == NO_CUT)
+		{
+			nominal += chunk_size;
+			continue;
+		}
+		cuts.push_back(cut);
+		letter_cuts.push_back(letter_cut);
+		nominal = cut + chunk_size;
+	}
+	cuts.push_back(length);
+
+	const std::size_t num_chunks = cuts.size() - 1;
+	std::vector<std::vector<WORD_SPAN>> chunk_words(num_chunks);
+	std::vector<SEGMENTATION_RESULT> chunk_results(num_chunks);
+	pool.run(num_chunks, [&](std::size_t chunk, unsigned)
+	{
+		const std::size_t chunk_begin = cuts[chunk];
+		chunk_results[chunk] = try_break_sentence(chunk_words[chunk], in_sentence + chunk_begin, cuts[chunk + 1] - chunk_begin,
+			dict, mode, policy);
+		for (WORD_SPAN & word : chunk_words[chunk])
+		{
+			word.offset += chunk_begin;
+		}
+	});
+
+	// Stitch. A chunk's words start at its cut, so only an unknown word ending at a letter cut may continue past it.
+	word_breakdown.clear();
+	SEGMENTATION_RESULT result = { SEGMENTATION_STATUS::OK, length, 0 };
+	for (std::size_t chunk = 0; chunk < num_chunks; ++chunk)
+	{
+		auto first = chunk_words[chunk].begin();
+		if (letter_cuts[chunk] && first != chunk_words[chunk].end() && first->unknown &&
+			!word_breakdown.empty() && word_breakdown.back().unknown)
+		{
+			word_breakdown.back().length += first->length;
+			++first;
+		}
+		word_breakdown.insert(word_breakdown.end(), first, chunk_words[chunk].end());
+
+		if (chunk_results[chunk].status != SEGMENTATION_STATUS::OK)
+		{
+			result.status = SEGMENTATION_STATUS::IMPOSSIBLE_MATCH;
+			result.failure_offset = cuts[chunk] + chunk_results[chunk].failure_offset;
+			break;
+		}
+	}
+
+	for (const WORD_SPAN & word : word_breakdown)
+	{
+		result.num_unknown += word.unknown ? 1 : 0;
+	}
+	return result;
+}
+
+} // End Namespace
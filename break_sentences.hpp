@@ -0,0 +1,97 @@
+#ifndef SENTENCE_BREAKER_BREAK_SENTENCES_HPP
+#define SENTENCE_BREAKER_BREAK_SENTENCES_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "break_sentence.hpp"
+#include "work_stealing_pool.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+// Segmentations of a whole batch, in input order.
+//
+// Every worker appends the words it produces to its own buffer, and each input just records where its words landed,
+// so workers never share a cache line or a lock while segmenting. Reusing one BATCH_RESULT across batches keeps all
+// of its buffers warm, after which a batch allocates nothing.
+class BATCH_RESULT
+{
+public:
+	std::size_t size() const
+	{
+		return m_entries.size();
+	}
+
+	// Words of input `index`, as spans into that input
+	const WORD_SPAN * words_begin(std::size_t index) const
+	{
+		const ENTRY & entry = m_entries[index];
+		return m_worker_words[entry.worker].data() + entry.first_word;
+	}
+
+	const WORD_SPAN * words_end(std::size_t index) const
+	{
+		return words_begin(index) + m_entries[index].num_words;
+	}
+
+	std::size_t num_words(std::size_t index) const
+	{
+		return m_entries[index].num_words;
+	}
+
+private:
+	friend void break_sentences(const std::vector<std::string> &, BATCH_RESULT &, const DICTIONARY &,
+		WORK_STEALING_POOL &, SEGMENTATION_MODE);
+
+	struct ENTRY
+	{
+		unsigned worker;
+		std::size_t first_word;
+		std::size_t num_words;
+	};
+
+	std::vector<ENTRY> m_entries;
+	std::vector<std::vector<WORD_SPAN>> m_worker_words;  // One per worker
+	std::vector<std::vector<WORD_SPAN>> m_worker_scratch;
+};
+
+// Segments every input of the batch on the pool. DICTIONARY is read-only after load, so all workers share it.
+// Throws whatever break_sentence throws for the first failing input; batch_out is unspecified then.
+void break_sentences(const std::vector<std::string> & batch_in, BATCH_RESULT & batch_out, const DICTIONARY & dict,
+	WORK_STEALING_POOL & pool, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY);
+
+// Same on a pool that only lives for this call. n_threads == 0 means one per hardware thread.
+void break_sentences(const std::vector<std::string> & batch_in, BATCH_RESULT & batch_out, const DICTIONARY & dict,
+	unsigned n_threads, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY);
+
+// Copies the words out, batch_out[i] are the words of batch_in[i].
+void break_sentences(const std::vector<std::string> & batch_in, std::vector<std::vector<std::string>> & batch_out,
+	const DICTIONARY & dict, unsigned n_threads, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY);
+
+// Segmentation of one very long input (an OCR dump, stripped HTML) on the pool, with the same result as a sequential
+// try_break_sentence.
+//
+// The input is cut about every chunk_size characters, at a position no dictionary word can cross: the border of a run of
+// letters, or a position inside one where no word found by walking the trie from the dict.max_word_length()
+// characters before it ends past it. Every path through the word lattice goes through such a cut, so the chunks are
+// segmented independently, in parallel, and their words simply concatenated (unknown words on both sides of a cut
+// merged back into one). A chunk takes the first cut within overlap characters past its nominal end; with none there
+// it just grows to the next one.
+//
+// Exact for any dictionary, the walks are sized by its longest word. GREEDY with EMIT_UNKNOWN only cuts at run
+// borders, since its unknown words reach up to the next word start wherever that is.
+//
+// Throws std::invalid_argument when chunk_size is 0. An overlap of 0 is fine, a chunk then only cuts exactly at its
+// nominal end or grows.
+constexpr std::size_t PARALLEL_CHUNK_SIZE = std::size_t(1) << 16;
+constexpr std::size_t PARALLEL_OVERLAP    = 256;
+
+SEGMENTATION_RESULT try_break_sentence_parallel(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence,
+	std::size_t length, const DICTIONARY & dict, WORK_STEALING_POOL & pool,
+	SEGMENTATION_MODE mode = SEGMENTATION_MODE::FEWEST_WORDS, UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL,
+	std::size_t chunk_size = PARALLEL_CHUNK_SIZE, std::size_t overlap = PARALLEL_OVERLAP);
+
+} // End Namespace
+
+#endif
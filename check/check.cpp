@@ -0,0 +1,1166 @@
+// check - property checks: every faster or alternative path against the plain one it must agree with.
+//
+// Usage: make check (builds build/check and runs it on check/words.txt)
+//
+// The word list is small and synthetic: 3000 words strung together from syllables the way bench/bench.cpp makes its
+// own, each with a count so UNIGRAM_COST has costs to weigh, plus one very long word and a few non-ASCII ones. The
+// inputs are made from it with a fixed seed, so a failure reproduces. Each check prints how many cases it ran and the
+// first few inputs it failed on; the exit status is 1 if any failed.
+//
+// make also compiles check/words.txt into the program as check_dictionary.hpp (dictc --header, the way make embedded
+// does), so the embedded check only holds when the word list given is that same one.
+
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../dictionary.hpp"
+#include "../dictionary_handle.hpp"
+#include "../break_sentence.hpp"
+#include "../break_sentences.hpp"
+#include "../layered_dictionary.hpp"
+#include "../normalize.hpp"
+#include "../segmentation_cache.hpp"
+#include "../work_stealing_pool.hpp"
+#include "check_dictionary.hpp"
+
+using namespace SENTENCE_BREAKER;
+
+namespace
+{
+
+const SEGMENTATION_MODE MODES[] =
+{
+	SEGMENTATION_MODE::GREEDY, SEGMENTATION_MODE::FEWEST_WORDS, SEGMENTATION_MODE::UNIGRAM_COST
+};
+const UNKNOWN_POLICY POLICIES[] = { UNKNOWN_POLICY::FAIL, UNKNOWN_POLICY::EMIT_UNKNOWN };
+
+// Counts the cases of one property and reports those it doesn't hold for
+class CHECK
+{
+public:
+	explicit CHECK(const char * name)
+	:
+		m_name(name),
+		m_cases(0),
+		m_failures(0)
+	{
+
+	}
+
+	void expect(bool holds, const std::string & input)
+	{
+		++m_cases;
+		if (holds)
+		{
+			return;
+		}
+		if (m_failures < MAX_REPORTED)
+		{
+			const std::size_t shown = input.size() < 80 ? input.size() : 80;
+			std::printf("  %s fails on \"%s\"%s\n", m_name, input.substr(0, shown).c_str(), shown < input.size() ? "..." : "");
+		}
+		++m_failures;
+	}
+
+	// Prints the summary line, returns whether every case held
+	bool report() const
+	{
+		std::printf("%-40s %8zu cases  %s\n", m_name, m_cases, m_failures == 0 ? "ok" : "FAILED");
+		return m_failures == 0;
+	}
+
+private:
+	static const std::size_t MAX_REPORTED = 5;
+
+	const char * m_name;
+	std::size_t m_cases;
+	std::size_t m_failures;
+};
+
+// The dictionary and the inputs every check shares
+struct CHECK_DATA
+{
+	explicit CHECK_DATA(const char * word_list);
+
+	const char * word_list;
+	std::vector<std::string> words;   // As spelled in the list, counts left out
+	DICTIONARY dict;
+
+	std::vector<std::string> tokens;  // A few words each, some with unknown letters, case changes or punctuation
+	std::string clean_text;           // Words and separators only, so every mode segments all of it
+	std::string noisy_text;           // tokens run together, unknown letters and all
+};
+
+CHECK_DATA::CHECK_DATA(const char * word_list)
+:
+	word_list(word_list),
+	dict(word_list)
+{
+	std::ifstream ifs(word_list);
+	std::string token;
+	while (ifs >> token)
+	{
+		if (token.find_first_not_of("0123456789") != std::string::npos)
+		{
+			words.push_back(token);
+		}
+	}
+
+	std::mt19937 rng(4711);
+	static const char * const NOISE[] = { "qzx", "-", "'", "42", " ", "\xC3\x9F", "\xFF" };
+	for (std::size_t i = 0; i < 4000; ++i)
+	{
+		std::string token;
+		const std::size_t num_words = 1 + rng() % 5;
+		for (std::size_t j = 0; j < num_words; ++j)
+		{
+			std::string word = words[rng() % words.size()];
+			if (rng() % 8 == 0)
+			{
+				word[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(word[0])));
+			}
+			token += word;
+			if (rng() % 6 == 0)
+			{
+				token += NOISE[rng() % (sizeof(NOISE) / sizeof(NOISE[0]))];
+			}
+		}
+		tokens.push_back(token);
+	}
+
+	while (clean_text.size() < 60000)
+	{
+		clean_text += words[rng() % words.size()];
+		if (rng() % 10 == 0)
+		{
+			clean_text += rng() % 2 == 0 ? " " : ", ";
+		}
+	}
+	for (const std::string & token : tokens)
+	{
+		noisy_text += token;
+	}
+}
+
+bool same_words(const std::vector<WORD_SPAN> & a, const std::vector<WORD_SPAN> & b)
+{
+	if (a.size() != b.size())
+	{
+		return false;
+	}
+	for (std::size_t i = 0; i < a.size(); ++i)
+	{
+		if (a[i].offset != b[i].offset || a[i].length != b[i].length || a[i].unknown != b[i].unknown)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool same_result(const SEGMENTATION_RESULT & a, const SEGMENTATION_RESULT & b)
+{
+	return a.status == b.status && a.failure_offset == b.failure_offset && a.num_unknown == b.num_unknown;
+}
+
+// Every engine splits every token the same with dict as with reference
+template <typename DICT>
+void expect_same_segmentations(CHECK & check, const CHECK_DATA & data, const DICTIONARY & reference, const DICT & dict)
+{
+	std::vector<WORD_SPAN> expected_words;
+	std::vector<WORD_SPAN> words;
+	for (const std::string & token : data.tokens)
+	{
+		for (const SEGMENTATION_MODE mode : MODES)
+		{
+			for (const UNKNOWN_POLICY policy : POLICIES)
+			{
+				const SEGMENTATION_RESULT expected = try_break_sentence(expected_words, token, reference, mode, policy);
+				const SEGMENTATION_RESULT result = try_break_sentence(words, token, dict, mode, policy);
+				check.expect(same_result(result, expected) && same_words(words, expected_words), token);
+			}
+		}
+	}
+}
+
+// prefix_match answers the same with dict as with reference, for every prefix of every word and for each of them
+// with its last byte changed, which mostly falls off the trie
+template <typename DICT>
+void expect_same_prefixes(CHECK & check, const CHECK_DATA & data, const DICTIONARY & reference, const DICT & dict)
+{
+	std::mt19937 rng(99);
+	for (const std::string & word : data.words)
+	{
+		for (std::size_t length = 0; length <= word.size(); ++length)
+		{
+			std::string prefix = word.substr(0, length);
+			check.expect(dict.prefix_match(prefix.cbegin(), prefix.cend())
+				== reference.prefix_match(prefix.cbegin(), prefix.cend()), prefix);
+			if (length != 0)
+			{
+				prefix.back() = static_cast<char>(rng() % 2 == 0 ? 'a' + rng() % 26 : rng());
+				check.expect(dict.prefix_match(prefix.cbegin(), prefix.cend())
+					== reference.prefix_match(prefix.cbegin(), prefix.cend()), prefix);
+			}
+		}
+	}
+	check.expect(dict.max_word_length() == reference.max_word_length(), "max_word_length");
+}
+
+// The minimized DAWG is a smaller trie with the same words
+bool check_minimized(const CHECK_DATA & data)
+{
+	CHECK check("minimized equals plain");
+	DICTIONARY::LOAD_OPTIONS options;
+	options.minimize = true;
+	const DICTIONARY minimized(data.word_list, options);
+	check.expect(minimized.num_nodes() < data.dict.num_nodes(), "num_nodes");
+	expect_same_prefixes(check, data, data.dict, minimized);
+	expect_same_segmentations(check, data, data.dict, minimized);
+	return check.report();
+}
+
+// prefix_match_batch answers every query as prefix_match does, in batches of sizes around the lane count so lanes are
+// refilled mid batch and the last round runs short. Queries are words, their prefixes, near misses, upper case,
+// empty strings and non-ASCII ones, valid UTF-8 or not, mixed so lanes finish at different times.
+bool check_batch(const CHECK_DATA & data)
+{
+	CHECK check("prefix_match_batch equals prefix_match");
+	std::vector<std::string> queries;
+	std::mt19937 rng(5150);
+	static const char * const ODD[] =
+	{
+		"", "\xC3\x89t\xC3\xA9", "FU\xC3\x9F" "BALL", "\xC3", "\xFF\xFE", "\xE2\x82\xAC", "a\xF0\x9F\x98\x80", "\xED\xA0\x80"
+	};
+	for (const std::string & word : data.words)
+	{
+		queries.push_back(word);
+		queries.push_back(word.substr(0, rng() % (word.size() + 1)));
+		std::string changed = word;
+		changed[rng() % changed.size()] = static_cast<char>(rng() % 2 == 0 ? 'a' + rng() % 26 : rng());
+		queries.push_back(changed);
+		queries.push_back(word + "q");
+		std::string upper = word;
+		for (char & c : upper)
+		{
+			c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+		}
+		queries.push_back(upper);
+		if (rng() % 8 == 0)
+		{
+			queries.push_back(ODD[rng() % (sizeof(ODD) / sizeof(ODD[0]))]);
+		}
+	}
+
+	DICTIONARY::LOAD_OPTIONS options;
+	options.minimize = true;
+	const DICTIONARY minimized(data.word_list, options);
+	std::vector<std::pair<bool, bool>> results(queries.size());
+	for (const DICTIONARY * dict : { &data.dict, &minimized })
+	{
+		for (const std::size_t batch : { std::size_t(1), DICTIONARY::BATCH_LANES - 1, DICTIONARY::BATCH_LANES + 1,
+			queries.size() })
+		{
+			// Every result starts out wrong, so one the batch never writes shows
+			for (std::size_t query = 0; query < queries.size(); ++query)
+			{
+				const std::pair<bool, bool> match = dict->prefix_match(queries[query].cbegin(), queries[query].cend());
+				results[query] = std::make_pair(!match.first, !match.second);
+			}
+			for (std::size_t first = 0; first < queries.size(); first += batch)
+			{
+				const std::size_t count = std::min(batch, queries.size() - first);
+				dict->prefix_match_batch(&queries[first], count, &results[first]);
+			}
+			for (std::size_t query = 0; query < queries.size(); ++query)
+			{
+				check.expect(results[query] == dict->prefix_match(queries[query].cbegin(), queries[query].cend()),
+					queries[query]);
+			}
+		}
+	}
+	return check.report();
+}
+
+// Name of a new empty file for a compiled dictionary, for the caller to remove
+std::string temporary_file()
+{
+	char name[] = "/tmp/sentence_breaker_check_XXXXXX";
+	const int fd = mkstemp(name);
+	if (fd < 0)
+	{
+		std::perror("check: mkstemp");
+		std::exit(2);
+	}
+	close(fd);
+	return name;
+}
+
+// Writes "word<TAB>count" lines to a new temporary file, for the caller to remove
+std::string write_word_list(const std::map<std::string, std::uint64_t> & counts)
+{
+	const std::string name = temporary_file();
+	std::ofstream ofs(name);
+	for (const auto & word : counts)
+	{
+		ofs << word.first << '\t' << word.second << '\n';
+	}
+	return name;
+}
+
+// Three overlapping layers answer like one dictionary of their union. A word in several layers is counted differently
+// in each, and the union has its largest count; every list is topped up to the same total with a word of no letters,
+// which the engines never look up, so the union's cost of a word is the cheapest of its layers' costs.
+bool check_layered(const CHECK_DATA & data)
+{
+	CHECK check("layered equals union");
+	static const std::size_t NUM_LAYERS = 3;
+	static const char * const BALLAST = "~~~";
+
+	// Keyed folded, so no two entries merge when loaded
+	std::map<std::string, std::uint64_t> counts;
+	std::ifstream ifs(data.word_list);
+	std::string line;
+	while (std::getline(ifs, line))
+	{
+		std::istringstream fields(line);
+		std::string word;
+		std::uint64_t count = 1;
+		if (fields >> word)
+		{
+			fields >> count;
+			std::string folded(word.size(), '\0');
+			fold_text(word.data(), word.size(), &folded[0]);
+			counts[folded] += count;
+		}
+	}
+
+	std::mt19937 rng(2718);
+	std::map<std::string, std::uint64_t> layer_counts[NUM_LAYERS];
+	std::uint64_t totals[NUM_LAYERS] = {};
+	std::uint64_t union_total = 0;
+	for (const auto & word : counts)
+	{
+		const unsigned layers = 1 + rng() % ((1u << NUM_LAYERS) - 1);
+		bool largest = false;
+		for (std::size_t layer = 0; layer < NUM_LAYERS; ++layer)
+		{
+			if (layers & (1u << layer))
+			{
+				const std::uint64_t count = largest ? 1 + rng() % word.second : word.second;
+				largest = true;
+				layer_counts[layer][word.first] = count;
+				totals[layer] += count;
+			}
+		}
+		union_total += word.second;
+	}
+
+	std::uint64_t total = union_total;
+	for (const std::uint64_t layer_total : totals)
+	{
+		total = std::max(total, layer_total);
+	}
+	++total;
+	counts[BALLAST] = total - union_total;
+	std::vector<std::string> files(1, write_word_list(counts));
+	for (std::size_t layer = 0; layer < NUM_LAYERS; ++layer)
+	{
+		layer_counts[layer][BALLAST] = total - totals[layer];
+		files.push_back(write_word_list(layer_counts[layer]));
+	}
+
+	const DICTIONARY united(files[0].c_str());
+	const DICTIONARY base(files[1].c_str());
+	const DICTIONARY domain(files[2].c_str());
+	const DICTIONARY user(files[3].c_str());
+	for (const std::string & file : files)
+	{
+		std::remove(file.c_str());
+	}
+	LAYERED_DICTIONARY layered(base);
+	layered.add_layer(domain);
+	layered.add_layer(user);
+
+	expect_same_prefixes(check, data, united, layered);
+
+	// The cursors agree character by character, on every word and on every word with its last byte changed
+	for (const std::string & word : data.words)
+	{
+		std::string folded(word.size(), '\0');
+		fold_text(word.data(), word.size(), &folded[0]);
+		for (const bool changed : { false, true })
+		{
+			if (changed)
+			{
+				folded.back() = static_cast<char>('a' + rng() % 26);
+			}
+			DICTIONARY::CURSOR expected = united.cursor();
+			LAYERED_DICTIONARY::CURSOR cursor = layered.cursor();
+			bool holds = true;
+			for (const char c : folded)
+			{
+				const std::pair<bool, bool> expected_match = expected.advance(c);
+				const std::pair<bool, bool> match = cursor.advance(c);
+				holds = holds && match == expected_match && cursor.completion() == expected.completion()
+					&& (!match.first || cursor.cost() == expected.cost());
+			}
+			check.expect(holds, folded);
+		}
+	}
+
+	expect_same_segmentations(check, data, united, layered);
+	return check.report();
+}
+
+// One load of the filter check: the options, and what must come out of the word list of check_filters
+struct FILTER_CASE
+{
+	const char * name;
+	std::size_t min_length;
+	std::size_t max_length;
+	bool letters_only;
+	const char * alphabet;
+	std::uint32_t min_count;
+	std::set<std::string> kept;  // Folded
+	std::size_t duplicates;
+	std::size_t filtered_length;
+	std::size_t filtered_alphabet;
+	std::size_t filtered_count;
+};
+
+// The load filters drop exactly the words they should from a small list with counts, duplicates, a word counted 0,
+// words with non-letters, non-ASCII ones and malformed UTF-8, and the report counts them and describes the trie that is left: a
+// plain trie has a node per prefix of the kept words.
+bool check_filters()
+{
+	CHECK check("load filters and report");
+	static const char * const WORD_LIST =
+		"apple\t5\nApple\t3\napp\t1\napply\t2\nbanana\t10\nban\t0\ncat\ne-mail\t4\n3rd\t2\n"
+		"Stra\xC3\x9F" "e\t6\nstra\xC3\x9F" "e\t1\n\xC3\xBC" "ber\t3\nzz\t1\na\t9\n"
+		"caf\xC3\xA9\t2\ncaf\xA9\t1\ncaf\xC3\t1\n";
+	static const std::size_t TOKENS = 17;
+	const std::string strasse = "stra\xC3\x9F" "e";
+	const std::string uber = "\xC3\xBC" "ber";
+	const std::string cafe = "caf\xC3\xA9";
+	const std::string stray = "caf\xA9";      // A continuation byte with no lead, one of the bytes of é
+	const std::string truncated = "caf\xC3";  // é without its continuation byte
+
+	const FILTER_CASE CASES[] =
+	{
+		{ "none", 0, 0, false, "", 0,
+			{ "apple", "app", "apply", "banana", "cat", "e-mail", "3rd", strasse, uber, "zz", "a", cafe, stray,
+				truncated }, 2, 0, 0, 1 },
+		{ "min_length 3", 3, 0, false, "", 0,
+			{ "apple", "app", "apply", "banana", "cat", "e-mail", "3rd", strasse, uber, cafe, stray, truncated },
+			2, 2, 0, 1 },
+		{ "max_length 4", 0, 4, false, "", 0, { "app", "cat", "3rd", uber, "zz", "a", cafe, stray, truncated },
+			0, 7, 0, 1 },
+		{ "letters_only", 0, 0, true, "", 0,
+			{ "apple", "app", "apply", "banana", "cat", strasse, uber, "zz", "a", cafe }, 2, 0, 4, 1 },
+		{ "alphabet a-z", 0, 0, false, "abcdefghijklmnopqrstuvwxyz", 0,
+			{ "apple", "app", "apply", "banana", "cat", "zz", "a" }, 1, 0, 8, 1 },
+		{ "alphabet upper case", 0, 0, false, "ABCDELNPY-", 0, { "apple", "app", "apply", "banana", "a" }, 1, 0, 10, 1 },
+		{ "alphabet non-ASCII", 0, 0, false, "STRA\xC3\x9F" "E", 0, { strasse, "a" }, 1, 0, 13, 1 },
+		{ "alphabet with \xC3\x89", 0, 0, false, "ACF\xC3\x89", 0, { cafe, "a" }, 0, 0, 14, 1 },
+		{ "min_count 3", 0, 0, false, "", 3, { "apple", "banana", "e-mail", strasse, uber, "a" }, 2, 0, 0, 9 },
+		{ "all of them", 2, 5, true, "", 2, { "apple", "apply", uber, cafe }, 1, 5, 3, 4 }
+	};
+
+	const std::string word_list = temporary_file();
+	std::ofstream(word_list) << WORD_LIST;
+	const std::string all[] =
+	{
+		"apple", "app", "apply", "banana", "ban", "cat", "e-mail", "3rd", strasse, uber, "zz", "a", "ap", "bananas",
+		cafe, stray, truncated
+	};
+	for (const FILTER_CASE & filter : CASES)
+	{
+		DICTIONARY::LOAD_OPTIONS options;
+		options.min_length = filter.min_length;
+		options.max_length = filter.max_length;
+		options.letters_only = filter.letters_only;
+		options.alphabet = filter.alphabet;
+		options.min_count = filter.min_count;
+		const DICTIONARY dict(word_list.c_str(), options);
+
+		for (const std::string & word : all)
+		{
+			check.expect(dict.prefix_match(word.cbegin(), word.cend()).first == (filter.kept.count(word) != 0),
+				std::string(filter.name) + ": " + word);
+		}
+
+		// The trie the kept words make: a node per prefix, the empty one included, and an edge into every one but that
+		std::set<std::string> prefixes;
+		std::set<std::string> parents;
+		std::size_t max_depth = 0;
+		for (const std::string & word : filter.kept)
+		{
+			for (std::size_t length = 0; length <= word.size(); ++length)
+			{
+				prefixes.insert(word.substr(0, length));
+				if (length != 0)
+				{
+					parents.insert(word.substr(0, length - 1));
+				}
+			}
+			max_depth = std::max(max_depth, word.size());
+		}
+
+		const DICTIONARY::REPORT report = dict.report();
+		check.expect(report.tokens == TOKENS && report.duplicates == filter.duplicates
+			&& report.filtered_length == filter.filtered_length && report.filtered_alphabet == filter.filtered_alphabet
+			&& report.filtered_count == filter.filtered_count, std::string(filter.name) + ": load report");
+		check.expect(report.words == filter.kept.size() && report.nodes == prefixes.size()
+			&& report.max_depth == max_depth && report.average_branching
+				== static_cast<double>(prefixes.size() - 1) / static_cast<double>(parents.size()),
+			std::string(filter.name) + ": trie report");
+
+		options.minimize = true;
+		const DICTIONARY::REPORT minimized = DICTIONARY(word_list.c_str(), options).report();
+		check.expect(minimized.words == report.words && minimized.nodes <= report.nodes
+			&& minimized.filtered_count == report.filtered_count, std::string(filter.name) + ": minimized report");
+	}
+	std::remove(word_list.c_str());
+	return check.report();
+}
+
+// A dictionary saved by dictc and mapped back, or compiled into the program, is the one that was loaded
+bool check_compiled(const CHECK_DATA & data)
+{
+	CHECK check("compiled and embedded equal loaded");
+	const std::string compiled = temporary_file();
+
+	DICTIONARY::LOAD_OPTIONS options;
+	for (const bool minimize : { false, true })
+	{
+		options.minimize = minimize;
+		DICTIONARY(data.word_list, options).save(compiled.c_str());
+		const DICTIONARY mapped(compiled.c_str(), DICTIONARY::MAPPED());
+		check.expect(mapped.num_nodes() == DICTIONARY(data.word_list, options).num_nodes(), "num_nodes");
+		expect_same_prefixes(check, data, data.dict, mapped);
+		expect_same_segmentations(check, data, data.dict, mapped);
+	}
+	std::remove(compiled.c_str());
+
+	const DICTIONARY embedded(EMBEDDED_TABLES::check_dictionary);
+	expect_same_prefixes(check, data, data.dict, embedded);
+	expect_same_segmentations(check, data, data.dict, embedded);
+	return check.report();
+}
+
+// The match links find the words restarted walks do: the SCANNER reports each word ending at a position, longest
+// first, and the lattice engines give the same splits and candidates with the links as without
+bool check_match_links(const CHECK_DATA & data)
+{
+	CHECK check("match links equal plain lookups");
+	DICTIONARY::LOAD_OPTIONS options;
+	options.match_links = true;
+	const DICTIONARY linked(data.word_list, options);
+	check.expect(linked.has_match_links(), "has_match_links");
+
+	// (length, cost) of every word ending at each position
+	typedef std::vector<std::pair<std::size_t, DICTIONARY::COST>> MATCHES;
+	MATCHES expected;
+	MATCHES scanned;
+	std::string folded;
+	for (const std::string & token : data.tokens)
+	{
+		folded.resize(token.size());
+		fold_text(token.data(), token.size(), &folded[0]);
+		DICTIONARY::SCANNER scanner = linked.scanner();
+		for (std::size_t end = 1; end <= folded.size(); ++end)
+		{
+			expected.clear();
+			for (std::size_t start = 0; start < end; ++start)
+			{
+				DICTIONARY::CURSOR cursor = data.dict.cursor();
+				std::pair<bool, bool> match;
+				for (std::size_t i = start; i < end; ++i)
+				{
+					match = cursor.advance(folded[i]);
+				}
+				if (match.first)
+				{
+					expected.emplace_back(end - start, cursor.cost());
+				}
+			}
+
+			scanned.clear();
+			scanner.advance(folded[end - 1]);
+			scanner.for_each_word([&scanned](std::size_t length, DICTIONARY::COST cost)
+			{
+				scanned.emplace_back(length, cost);
+			});
+			check.expect(scanned == expected, folded.substr(0, end));
+		}
+	}
+
+	const std::string compiled = temporary_file();
+	linked.save(compiled.c_str());
+	const DICTIONARY mapped(compiled.c_str(), DICTIONARY::MAPPED());
+	std::remove(compiled.c_str());
+	check.expect(mapped.has_match_links(), "has_match_links, mapped");
+
+	std::vector<SEGMENTATION_CANDIDATE> expected_candidates;
+	std::vector<SEGMENTATION_CANDIDATE> candidates;
+	for (const DICTIONARY * dict : { &linked, &mapped })
+	{
+		expect_same_segmentations(check, data, data.dict, *dict);
+		for (const std::string & token : data.tokens)
+		{
+			for (const SEGMENTATION_MODE mode : MODES)
+			{
+				for (const UNKNOWN_POLICY policy : POLICIES)
+				{
+					const SEGMENTATION_RESULT expected_result = break_sentence_n_best(expected_candidates, token,
+						data.dict, 6, mode, policy);
+					const SEGMENTATION_RESULT result = break_sentence_n_best(candidates, token, *dict, 6, mode, policy);
+					bool holds = same_result(result, expected_result) && candidates.size() == expected_candidates.size();
+					for (std::size_t i = 0; holds && i < candidates.size(); ++i)
+					{
+						holds = candidates[i].cost == expected_candidates[i].cost
+							&& same_words(candidates[i].words, expected_candidates[i].words);
+					}
+					check.expect(holds, token);
+				}
+			}
+		}
+	}
+	return check.report();
+}
+
+// fold_and_classify, vectorized or not per ARCHFLAGS, folds and splits exactly like a scalar loop of
+// fold_code_point, on random mixes of ASCII, multi-byte code points and bytes that are no valid UTF-8
+bool check_fold(const CHECK_DATA & data)
+{
+	CHECK check("fold_and_classify equals fold_code_point");
+	static const char * const PIECES[] =
+	{
+		"a", "Z", " ", "-", "\xC3\xA9", "\xC3\x89", "\xC3\x9F", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xD0\x96",
+		"\xE1\xBA\x9E", "\xC4\xB0", "\xEF\xBC\xA1", "\x80", "\xC3", "\xE2\x82", "\xED\xA0\x80"
+	};
+	std::mt19937 rng(31337);
+	std::vector<std::size_t> run_ends;
+	std::vector<std::size_t> expected_run_ends;
+	for (std::size_t i = 0; i < 100000; ++i)
+	{
+		std::string text;
+		const std::size_t length = 1 + rng() % 120;
+		while (text.size() < length)
+		{
+			text += rng() % 3 == 0 ? std::string(1, static_cast<char>(rng())) : PIECES[rng() % (sizeof(PIECES) / sizeof(PIECES[0]))];
+		}
+
+		std::string expected(text.size(), '\0');
+		expected_run_ends.clear();
+		bool expected_first = false;
+		bool run_letter = false;
+		for (std::size_t offset = 0; offset < text.size();)
+		{
+			bool letter;
+			const std::size_t bytes = fold_code_point(text.data() + offset, text.size() - offset, &expected[offset], letter);
+			if (offset == 0)
+			{
+				expected_first = run_letter = letter;
+			}
+			else if (letter != run_letter)
+			{
+				expected_run_ends.push_back(offset);
+				run_letter = letter;
+			}
+			offset += bytes;
+		}
+		expected_run_ends.push_back(text.size());
+
+		std::string folded(text.size(), '\0');
+		const bool first = fold_and_classify(text.data(), text.size(), &folded[0], run_ends);
+		check.expect(first == expected_first && run_ends == expected_run_ends && folded == expected, text);
+
+		std::string folded_text(text.size(), '\0');
+		fold_text(text.data(), text.size(), &folded_text[0]);
+		check.expect(folded_text == expected, text);
+	}
+
+	// Upper case with a lower case of the same length folds, other code points stay as they are
+	static const char * const FOLDS[][2] =
+	{
+		{ "ABCxyz", "abcxyz" },
+		{ "\xC3\x84\xC3\x96\xC3\x9C", "\xC3\xA4\xC3\xB6\xC3\xBC" },                     // ÄÖÜ
+		{ "\xD0\x96\xCE\xA3", "\xD0\xB6\xCF\x83" },                                     // ЖΣ
+		{ "\xEF\xBC\xA1", "\xEF\xBD\x81" },                                             // Fullwidth A
+		{ "\xE1\xBA\x9E\xC4\xB0", "\xE1\xBA\x9E\xC4\xB0" }                              // ẞİ
+	};
+	for (const auto & fold : FOLDS)
+	{
+		const std::string text = fold[0];
+		std::string folded(text.size(), '\0');
+		fold_text(text.data(), text.size(), &folded[0]);
+		check.expect(folded == fold[1], text);
+	}
+
+	// The dictionary folds its words the same way, so they are found in upper case as well
+	for (const std::string & word : data.words)
+	{
+		std::string upper = word;
+		for (char & c : upper)
+		{
+			c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+		}
+		check.expect(data.dict.prefix_match(upper.cbegin(), upper.cend()).first, upper);
+	}
+	return check.report();
+}
+
+// Every split of token[offset, end) into dictionary words, by brute force over prefix_match
+void all_segmentations(const DICTIONARY & dict, const std::string & token, std::size_t offset,
+	std::vector<WORD_SPAN> & words, std::vector<std::vector<WORD_SPAN>> & segmentations)
+{
+	if (offset == token.size())
+	{
+		segmentations.push_back(words);
+		return;
+	}
+	for (std::size_t end = offset + 1; end <= token.size(); ++end)
+	{
+		const std::pair<bool, bool> match = dict.prefix_match(token.cbegin() + offset, token.cbegin() + end);
+		if (match.first)
+		{
+			words.push_back(WORD_SPAN{ offset, end - offset, false });
+			all_segmentations(dict, token, end, words, segmentations);
+			words.pop_back();
+		}
+		if (!match.second)
+		{
+			break;
+		}
+	}
+}
+
+// The best of the n best is the lattice engines' split, and the rest follow in order, each split once
+bool check_n_best(const CHECK_DATA & data)
+{
+	CHECK check("n-best K=1 equals the lattice engines");
+	std::vector<WORD_SPAN> words;
+	std::vector<SEGMENTATION_CANDIDATE> candidates;
+	for (const std::string & token : data.tokens)
+	{
+		for (const SEGMENTATION_MODE mode : { SEGMENTATION_MODE::FEWEST_WORDS, SEGMENTATION_MODE::UNIGRAM_COST })
+		{
+			for (const UNKNOWN_POLICY policy : POLICIES)
+			{
+				const SEGMENTATION_RESULT expected = try_break_sentence(words, token, data.dict, mode, policy);
+				const SEGMENTATION_RESULT result = break_sentence_n_best(candidates, token, data.dict, 1, mode, policy);
+				if (expected.status == SEGMENTATION_STATUS::OK)
+				{
+					check.expect(same_result(result, expected) && candidates.size() == 1
+						&& same_words(candidates[0].words, words) && candidates[0].num_unknown == expected.num_unknown, token);
+				}
+				else
+				{
+					check.expect(result.status == expected.status && candidates.empty(), token);
+				}
+			}
+		}
+	}
+
+	CHECK ordered("n-best ordered, distinct and complete");
+	std::vector<WORD_SPAN> scratch;
+	std::vector<std::vector<WORD_SPAN>> segmentations;
+	for (const std::string & token : data.tokens)
+	{
+		if (token.size() > 16 || token.find_first_not_of("abcdefghijklmnopqrstuvwxyz") != std::string::npos)
+		{
+			continue;
+		}
+		segmentations.clear();
+		all_segmentations(data.dict, token, 0, scratch, segmentations);
+		break_sentence_n_best(candidates, token, data.dict, 1000, SEGMENTATION_MODE::FEWEST_WORDS);
+		bool holds = candidates.size() == segmentations.size();
+		for (std::size_t i = 0; holds && i < candidates.size(); ++i)
+		{
+			holds = candidates[i].cost == candidates[i].words.size() && (i == 0 || candidates[i - 1].cost <= candidates[i].cost);
+			for (std::size_t j = 0; holds && j < i; ++j)
+			{
+				holds = !same_words(candidates[i].words, candidates[j].words);
+			}
+		}
+		ordered.expect(holds, token);
+	}
+
+	bool threw = false;
+	try
+	{
+		break_sentence_n_best(candidates, data.tokens[0], data.dict, MAX_N_BEST + 1);
+	}
+	catch (const std::invalid_argument &)
+	{
+		threw = true;
+	}
+	check.expect(threw, "k over MAX_N_BEST");
+
+	// The largest lattice there may be is segmented, one byte more is not
+	std::string longest;
+	while (longest.size() < MAX_N_BEST_ENTRIES / MAX_N_BEST - 1)
+	{
+		longest += data.words[longest.size() % data.words.size()];
+	}
+	longest.resize(MAX_N_BEST_ENTRIES / MAX_N_BEST - 1);
+	check.expect(break_sentence_n_best(candidates, longest, data.dict, MAX_N_BEST, SEGMENTATION_MODE::FEWEST_WORDS,
+		UNKNOWN_POLICY::EMIT_UNKNOWN).status == SEGMENTATION_STATUS::OK && !candidates.empty(), "largest lattice");
+	longest += 'a';
+	threw = false;
+	try
+	{
+		break_sentence_n_best(candidates, longest, data.dict, MAX_N_BEST);
+	}
+	catch (const std::length_error &)
+	{
+		threw = true;
+	}
+	check.expect(threw, "lattice over MAX_N_BEST_ENTRIES");
+
+	const bool passed = check.report();
+	return ordered.report() && passed;
+}
+
+// UNIGRAM_COST with EMIT_UNKNOWN segments a run of letters up to MAX_UNIGRAM_RUN bytes and throws on one byte more,
+// try_break_sentence too. The limit is per run and only for that mode and policy.
+bool check_unigram_run(const CHECK_DATA & data)
+{
+	CHECK check("unigram runs up to MAX_UNIGRAM_RUN");
+
+	// Plain lower case words run together, so the whole of it is one run of letters
+	std::string run;
+	for (std::size_t i = 0; run.size() < MAX_UNIGRAM_RUN - 1; ++i)
+	{
+		const std::string & word = data.words[i % data.words.size()];
+		if (word.find_first_not_of("abcdefghijklmnopqrstuvwxyz") == std::string::npos)
+		{
+			run += word;
+		}
+	}
+	run.resize(MAX_UNIGRAM_RUN - 1);
+
+	std::vector<WORD_SPAN> words;
+	SEGMENTATION_RESULT result = try_break_sentence(words, run, data.dict, SEGMENTATION_MODE::UNIGRAM_COST,
+		UNKNOWN_POLICY::EMIT_UNKNOWN);
+	check.expect(result.status == SEGMENTATION_STATUS::OK && !words.empty()
+		&& words.back().offset + words.back().length == run.size(), "longest run");
+
+	// Two runs each under the limit, together over it
+	const std::string two_runs = run + " " + run.substr(0, 16);
+	result = try_break_sentence(words, two_runs, data.dict, SEGMENTATION_MODE::UNIGRAM_COST,
+		UNKNOWN_POLICY::EMIT_UNKNOWN);
+	check.expect(result.status == SEGMENTATION_STATUS::OK && words.back().offset + words.back().length == two_runs.size(),
+		"two runs");
+
+	run += 'a';
+	bool threw = false;
+	try
+	{
+		try_break_sentence(words, run, data.dict, SEGMENTATION_MODE::UNIGRAM_COST, UNKNOWN_POLICY::EMIT_UNKNOWN);
+	}
+	catch (const std::length_error &)
+	{
+		threw = true;
+	}
+	check.expect(threw, "run over MAX_UNIGRAM_RUN");
+
+	try_break_sentence(words, run, data.dict, SEGMENTATION_MODE::UNIGRAM_COST, UNKNOWN_POLICY::FAIL);
+	check.expect(std::none_of(words.begin(), words.end(), [](const WORD_SPAN & word) { return word.unknown; }),
+		"run over MAX_UNIGRAM_RUN without EMIT_UNKNOWN");
+	result = try_break_sentence(words, run, data.dict, SEGMENTATION_MODE::FEWEST_WORDS, UNKNOWN_POLICY::EMIT_UNKNOWN);
+	check.expect(result.status == SEGMENTATION_STATUS::OK, "run over MAX_UNIGRAM_RUN in FEWEST_WORDS mode");
+
+	return check.report();
+}
+
+// A SEGMENTATION_CACHE answers exactly what try_break_sentence does, failures included, whether it hits or misses.
+// The cache is tiny, so sets overflow and evict all the time; every token goes in twice in a row, the second time a
+// hit if it was short enough to keep, and comes back once more a few tokens later, a hit or an evicted miss.
+bool check_cache(const CHECK_DATA & data)
+{
+	CHECK check("cache equals try_break_sentence");
+
+	// Short tokens too, so most fit a way: single words, pairs and words with noise
+	std::vector<std::string> tokens = data.tokens;
+	std::mt19937 rng(1234);
+	for (std::size_t i = 0; i < 2000; ++i)
+	{
+		std::string token = data.words[rng() % data.words.size()];
+		if (rng() % 2 == 0)
+		{
+			token += data.words[rng() % data.words.size()];
+		}
+		if (rng() % 4 == 0)
+		{
+			token.insert(rng() % (token.size() + 1), rng() % 2 == 0 ? "qzx" : "-");
+		}
+		tokens.push_back(token);
+	}
+
+	std::vector<WORD_SPAN> expected_words;
+	std::vector<WORD_SPAN> words;
+	for (const SEGMENTATION_MODE mode : MODES)
+	{
+		for (const UNKNOWN_POLICY policy : POLICIES)
+		{
+			SEGMENTATION_CACHE cache(data.dict, 4096, mode, policy);
+			for (std::size_t i = 0; i < tokens.size(); ++i)
+			{
+				const std::string & now = tokens[i];
+				const std::string & later = tokens[i < 3 ? 0 : i - 3];
+				for (const std::string * token : { &now, &now, &later })
+				{
+					const SEGMENTATION_RESULT expected = try_break_sentence(expected_words, *token, data.dict, mode, policy);
+					const SEGMENTATION_RESULT result = cache.try_break_sentence(words, token->data(), token->size());
+					check.expect(same_result(result, expected) && same_words(words, expected_words), *token);
+				}
+			}
+			const SEGMENTATION_CACHE::COUNTERS & counters = cache.counters();
+			check.expect(counters.hits != 0 && counters.evictions != 0 && counters.uncacheable != 0, "counters");
+			check.expect(counters.hits + counters.misses == 3 * tokens.size(), "hits + misses");
+		}
+	}
+
+	// A cache of a single set evicts its least recently used way: a, b, c and d fill it, a is used again, so e takes
+	// b's way
+	SEGMENTATION_CACHE lru(data.dict, 0);
+	const std::string & a = data.words[1];
+	const std::string & b = data.words[2];
+	const std::string & c = data.words[3];
+	const std::string & d = data.words[4];
+	const std::string & e = data.words[5];
+	for (const std::string * token : { &a, &b, &c, &d, &a, &e, &a, &c, &d, &e, &b })
+	{
+		lru.try_break_sentence(words, token->data(), token->size());
+	}
+	const SEGMENTATION_CACHE::COUNTERS & counters = lru.counters();
+	check.expect(counters.misses == 6 && counters.hits == 5 && counters.evictions == 2, "least recently used");
+	return check.report();
+}
+
+// Readers segmenting through a DICTIONARY_HANDLE while it is reloaded over and over always hold a whole dictionary,
+// one of the two it alternates between, and segment exactly as that one does. A snapshot held across every reload
+// keeps its dictionary alive and working; once it is dropped, the handle frees every replaced dictionary.
+bool check_handle(const CHECK_DATA & data)
+{
+	CHECK check("dictionary handle under reloads");
+	static const std::size_t NUM_TOKENS = 200;
+	static const unsigned NUM_READERS = 4;
+	static const unsigned NUM_RELOADS = 40;
+
+	// Two versions that segment differently, told apart by their node count
+	DICTIONARY::LOAD_OPTIONS options[2];
+	options[1].min_length = 5;
+	std::vector<std::vector<WORD_SPAN>> expected[2];
+	std::size_t num_nodes[2];
+	for (std::size_t version = 0; version < 2; ++version)
+	{
+		const DICTIONARY dict(data.word_list, options[version]);
+		num_nodes[version] = dict.num_nodes();
+		expected[version].resize(NUM_TOKENS);
+		for (std::size_t token = 0; token < NUM_TOKENS; ++token)
+		{
+			try_break_sentence(expected[version][token], data.tokens[token], dict, SEGMENTATION_MODE::FEWEST_WORDS,
+				UNKNOWN_POLICY::EMIT_UNKNOWN);
+		}
+	}
+	check.expect(num_nodes[0] != num_nodes[1], "versions differ");
+
+	std::atomic<unsigned> loads(0);
+	const auto loader = [&](std::size_t version)
+	{
+		return [&, version]
+		{
+			loads.fetch_add(1, std::memory_order_relaxed);
+			return std::unique_ptr<DICTIONARY>(new DICTIONARY(data.word_list, options[version]));
+		};
+	};
+
+	DICTIONARY_HANDLE handle(std::unique_ptr<DICTIONARY>(new DICTIONARY(data.word_list, options[0])));
+	DICTIONARY_HANDLE::READER pinning_reader = handle.reader();
+	std::unique_ptr<DICTIONARY_HANDLE::SNAPSHOT> pinned(new DICTIONARY_HANDLE::SNAPSHOT(pinning_reader.acquire()));
+
+	// Per reader: snapshots taken, those that were no whole version or segmented unlike it, versions seen
+	struct READER_RESULT
+	{
+		std::size_t snapshots;
+		std::size_t wrong;
+		unsigned seen;
+	};
+	std::vector<READER_RESULT> results(NUM_READERS, READER_RESULT{ 0, 0, 0 });
+	std::atomic<bool> stop(false);
+	std::vector<std::thread> readers;
+	for (unsigned reader_index = 0; reader_index < NUM_READERS; ++reader_index)
+	{
+		readers.emplace_back([&, reader_index]
+		{
+			READER_RESULT & result = results[reader_index];
+			DICTIONARY_HANDLE::READER reader = handle.reader();
+			std::vector<WORD_SPAN> words;
+			for (std::size_t token = reader_index; !stop.load(std::memory_order_relaxed); token = (token + 1) % NUM_TOKENS)
+			{
+				const DICTIONARY_HANDLE::SNAPSHOT dict = reader.acquire();
+				const std::size_t version = dict->num_nodes() == num_nodes[0] ? 0 : 1;
+				try_break_sentence(words, data.tokens[token], *dict, SEGMENTATION_MODE::FEWEST_WORDS,
+					UNKNOWN_POLICY::EMIT_UNKNOWN);
+				++result.snapshots;
+				result.seen |= 1u << version;
+				if (dict->num_nodes() != num_nodes[version] || !same_words(words, expected[version][token]))
+				{
+					++result.wrong;
+				}
+			}
+		});
+	}
+
+	// Waits for the background thread to get through a reload
+	const auto settle = [&](std::uint64_t version, unsigned num_loads)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while ((handle.version() < version || loads.load() < num_loads) && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	};
+	unsigned num_loads = 0;
+	for (unsigned reload = 1; reload <= NUM_RELOADS; ++reload)
+	{
+		handle.reload(loader(reload % 2));
+		settle(reload, ++num_loads);
+		check.expect(handle.version() == reload && !handle.last_reload_error(), "reload");
+	}
+
+	// A loader that throws publishes nothing
+	handle.reload([&]() -> std::unique_ptr<DICTIONARY>
+	{
+		loads.fetch_add(1, std::memory_order_relaxed);
+		throw std::runtime_error("no dictionary");
+	});
+	settle(NUM_RELOADS, ++num_loads);
+	const auto error_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (!handle.last_reload_error() && std::chrono::steady_clock::now() < error_deadline)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	check.expect(handle.version() == NUM_RELOADS && handle.last_reload_error(), "failed reload");
+	check.expect(loads.load() == num_loads, "loads");
+
+	// The pinned snapshot entered before every publish, so nothing replaced since could be freed, and its dictionary
+	// still segments like the first version
+	check.expect(handle.num_retired() == NUM_RELOADS, "retired while pinned");
+	std::vector<WORD_SPAN> words;
+	for (std::size_t token = 0; token < NUM_TOKENS; ++token)
+	{
+		try_break_sentence(words, data.tokens[token], **pinned, SEGMENTATION_MODE::FEWEST_WORDS,
+			UNKNOWN_POLICY::EMIT_UNKNOWN);
+		check.expect(same_words(words, expected[0][token]), data.tokens[token]);
+	}
+	pinned.reset();
+
+	stop.store(true);
+	for (std::thread & reader : readers)
+	{
+		reader.join();
+	}
+	unsigned seen = 0;
+	for (const READER_RESULT & result : results)
+	{
+		check.expect(result.snapshots != 0 && result.wrong == 0, "reader");
+		seen |= result.seen;
+	}
+	check.expect(seen == 3, "both versions read");
+
+	// With no snapshot left, the background thread frees them all within a few reclaim intervals
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (handle.num_retired() != 0 && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	check.expect(handle.num_retired() == 0, "reclaimed");
+	return check.report();
+}
+
+// try_break_sentence_parallel gives exactly the sequential split, whatever the chunk size and overlap
+bool check_parallel(const CHECK_DATA & data)
+{
+	CHECK check("parallel equals sequential");
+	WORK_STEALING_POOL pool(4);
+	std::vector<WORD_SPAN> sequential;
+	std::vector<WORD_SPAN> parallel;
+	for (const std::string * text : { &data.clean_text, &data.noisy_text })
+	{
+		for (const SEGMENTATION_MODE mode : MODES)
+		{
+			for (const UNKNOWN_POLICY policy : POLICIES)
+			{
+				const SEGMENTATION_RESULT expected = try_break_sentence(sequential, *text, data.dict, mode, policy);
+				for (const std::size_t chunk_size : { 1, 7, 64, 997, 1 << 16 })
+				{
+					for (const std::size_t overlap : { 0, 3, 256 })
+					{
+						const SEGMENTATION_RESULT result = try_break_sentence_parallel(parallel, text->data(),
+							text->size(), data.dict, pool, mode, policy, chunk_size, overlap);
+						check.expect(same_result(result, expected) && same_words(parallel, sequential), *text);
+					}
+				}
+			}
+		}
+	}
+
+	bool threw = false;
+	try
+	{
+		try_break_sentence_parallel(parallel, data.clean_text.data(), data.clean_text.size(), data.dict, pool,
+			SEGMENTATION_MODE::FEWEST_WORDS, UNKNOWN_POLICY::FAIL, 0);
+	}
+	catch (const std::invalid_argument &)
+	{
+		threw = true;
+	}
+	check.expect(threw, "chunk_size 0");
+	return check.report();
+}
+
+} // End Anonymous Namespace
+
+int main(int argc, char ** argv)
+{
+	if (argc != 2)
+	{
+		std::fprintf(stderr, "Usage: %s <word list>\n", argv[0]);
+		return 2;
+	}
+
+	const CHECK_DATA data(argv[1]);
+	bool passed = true;
+	passed = check_parallel(data) && passed;
+	passed = check_minimized(data) && passed;
+	passed = check_layered(data) && passed;
+	passed = check_batch(data) && passed;
+	passed = check_filters() && passed;
+	passed = check_n_best(data) && passed;
+	passed = check_unigram_run(data) && passed;
+	passed = check_cache(data) && passed;
+	passed = check_handle(data) && passed;
+	passed = check_compiled(data) && passed;
+	passed = check_match_links(data) && passed;
+	passed = check_fold(data) && passed;
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+/*
+ * check_c - the C interface of sentence_breaker.h, compiled as C and linked against libsentence_breaker.so.
+ *
+ * Usage: make check (builds build/check_c and runs it on check/words.txt)
+ *
+ * Segments a few tokens made from the first words of the list, then takes every error path: null arguments, unknown
+ * flags, modes and policies, files that don't load, a token no split exists for, too small an output array. Each
+ * failing call must leave a message in sb_last_error. Prints one summary line like check does; the exit status is 1
+ * if any case failed. make check also makes sure the library exports nothing but the sb_* functions.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../sentence_breaker.h"
+
+#define MAX_WORDS 64
+
+static size_t cases;
+static size_t failures;
+
+static void expect(int holds, const char * what)
+{
+	++cases;
+	if (!holds)
+	{
+		if (failures < 5)
+		{
+			printf("  C interface fails on %s (last error \"%s\")\n", what, sb_last_error());
+		}
+		++failures;
+	}
+}
+
+/* The latest call failed and said why */
+static void expect_error(int holds, const char * what)
+{
+	expect(holds && sb_last_error() != NULL && sb_last_error()[0] != '\0', what);
+}
+
+static int segment(const sb_dictionary * dict, const char * text, int mode, int policy, uint32_t * word_ends,
+	uint8_t * unknown, sb_segmentation * result)
+{
+	return sb_segment(dict, text, strlen(text), mode, policy, word_ends, unknown, MAX_WORDS, result);
+}
+
+/* Words cover the text end to end, each ending after the one before */
+static int covers(const uint32_t * word_ends, const sb_segmentation * result, size_t length)
+{
+	size_t word;
+	for (word = 0; word < result->num_words; ++word)
+	{
+		if (word_ends[word] <= (word == 0 ? 0 : word_ends[word - 1]))
+		{
+			return 0;
+		}
+	}
+	return result->num_words != 0 && word_ends[result->num_words - 1] == length;
+}
+
+static void check_segment(const sb_dictionary * dict, const char * first, const char * second)
+{
+	char token[256];
+	uint32_t word_ends[MAX_WORDS];
+	uint8_t unknown[MAX_WORDS];
+	sb_segmentation result;
+	size_t num_words;
+	int mode;
+	int status;
+
+	snprintf(token, sizeof(token), "%s%s", first, second);
+	for (mode = SB_MODE_GREEDY; mode <= SB_MODE_UNIGRAM_COST; ++mode)
+	{
+		status = segment(dict, token, mode, SB_UNKNOWN_FAIL, word_ends, unknown, &result);
+		expect(status == SB_OK && covers(word_ends, &result, strlen(token)) && result.failure_offset == strlen(token)
+			&& result.num_unknown == 0 && unknown[0] == 0, token);
+	}
+
+	/* A run no word covers fails, or comes back flagged unknown */
+	snprintf(token, sizeof(token), "%sqzxqzx", first);
+	status = segment(dict, token, SB_MODE_FEWEST_WORDS, SB_UNKNOWN_FAIL, word_ends, NULL, &result);
+	expect(status == SB_IMPOSSIBLE_MATCH && result.failure_offset < strlen(token), "impossible match");
+	status = segment(dict, token, SB_MODE_FEWEST_WORDS, SB_UNKNOWN_EMIT, word_ends, unknown, &result);
+	expect(status == SB_OK && covers(word_ends, &result, strlen(token)) && result.num_words >= 2
+		&& result.num_unknown == 1 && unknown[result.num_words - 1] == 1, "unknown word");
+
+	/* Too small an array writes nothing but says how many words there are */
+	num_words = result.num_words;
+	word_ends[0] = 4711;
+	status = sb_segment(dict, token, strlen(token), SB_MODE_FEWEST_WORDS, SB_UNKNOWN_EMIT, word_ends, NULL,
+		num_words - 1, &result);
+	expect_error(status == SB_BUFFER_TOO_SMALL && result.num_words == num_words && word_ends[0] == 4711,
+		"buffer too small");
+	status = sb_segment(dict, token, strlen(token), SB_MODE_FEWEST_WORDS, SB_UNKNOWN_EMIT, NULL, NULL, 0, &result);
+	expect_error(status == SB_BUFFER_TOO_SMALL && result.num_words == num_words, "capacity 0");
+
+	status = sb_segment(dict, NULL, 0, SB_MODE_GREEDY, SB_UNKNOWN_FAIL, word_ends, NULL, MAX_WORDS, &result);
+	expect(status == SB_OK && result.num_words == 0 && result.failure_offset == 0, "empty input");
+}
+
+static void check_invalid(const sb_dictionary * dict)
+{
+	uint32_t word_ends[MAX_WORDS];
+	sb_segmentation result;
+
+	expect_error(sb_segment(NULL, "a", 1, SB_MODE_GREEDY, SB_UNKNOWN_FAIL, word_ends, NULL, MAX_WORDS, &result)
+		== SB_INVALID_ARGUMENT, "null dictionary");
+	expect_error(sb_segment(dict, NULL, 1, SB_MODE_GREEDY, SB_UNKNOWN_FAIL, word_ends, NULL, MAX_WORDS, &result)
+		== SB_INVALID_ARGUMENT, "null text");
+	expect_error(sb_segment(dict, "a", 1, SB_MODE_GREEDY, SB_UNKNOWN_FAIL, NULL, NULL, MAX_WORDS, &result)
+		== SB_INVALID_ARGUMENT, "null word_ends");
+	expect_error(sb_segment(dict, "a", 1, SB_MODE_GREEDY, SB_UNKNOWN_FAIL, word_ends, NULL, MAX_WORDS, NULL)
+		== SB_INVALID_ARGUMENT, "null result");
+	expect_error(sb_segment(dict, "a", 1, -1, SB_UNKNOWN_FAIL, word_ends, NULL, MAX_WORDS, &result)
+		== SB_INVALID_ARGUMENT, "mode -1");
+	expect_error(sb_segment(dict, "a", 1, SB_MODE_UNIGRAM_COST + 1, SB_UNKNOWN_FAIL, word_ends, NULL, MAX_WORDS,
+		&result) == SB_INVALID_ARGUMENT, "mode past the last");
+	expect_error(sb_segment(dict, "a", 1, SB_MODE_GREEDY, SB_UNKNOWN_EMIT + 1, word_ends, NULL, MAX_WORDS, &result)
+		== SB_INVALID_ARGUMENT, "unknown policy");
+}
+
+static void check_open(const char * word_list)
+{
+	expect_error(sb_dictionary_open(NULL, 0) == NULL, "null word list");
+	expect_error(sb_dictionary_open(word_list, 4u) == NULL, "unknown flags");
+	expect_error(sb_dictionary_open(word_list, SB_OPEN_MINIMIZE | SB_OPEN_MATCH_LINKS) == NULL,
+		"minimize with match links");
+	expect_error(sb_dictionary_open("/nonexistent/words.txt", 0) == NULL, "missing word list");
+	expect_error(sb_dictionary_open_compiled(NULL) == NULL, "null compiled path");
+	expect_error(sb_dictionary_open_compiled(word_list) == NULL, "word list as compiled dictionary");
+	sb_dictionary_close(NULL);
+}
+
+int main(int argc, char ** argv)
+{
+	char words[2][128];
+	FILE * list;
+	unsigned flags;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: %s <word list>\n", argv[0]);
+		return 2;
+	}
+
+	/* The first two plain lower case words of the list, counts and the rest skipped */
+	list = fopen(argv[1], "r");
+	if (list == NULL)
+	{
+		perror(argv[1]);
+		return 2;
+	}
+	{
+		size_t found = 0;
+		char token[128];
+		while (found < 2 && fscanf(list, "%127s", token) == 1)
+		{
+			if (strspn(token, "abcdefghijklmnopqrstuvwxyz") == strlen(token))
+			{
+				strcpy(words[found++], token);
+			}
+		}
+		fclose(list);
+		if (found < 2)
+		{
+			fprintf(stderr, "%s: fewer than two plain words\n", argv[1]);
+			return 2;
+		}
+	}
+
+	expect(sb_api_version() == SB_API_VERSION, "sb_api_version");
+	check_open(argv[1]);
+	for (flags = 0; flags <= SB_OPEN_MINIMIZE; ++flags)
+	{
+		sb_dictionary * const dict = sb_dictionary_open(argv[1], flags);
+		expect(dict != NULL, "sb_dictionary_open");
+		if (dict != NULL)
+		{
+			check_segment(dict, words[0], words[1]);
+			check_invalid(dict);
+			sb_dictionary_close(dict);
+		}
+	}
+	expect(sb_last_error() != NULL, "sb_last_error");
+
+	printf("%-40s %8lu cases  %s\n", "C interface", (unsigned long)cases, failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,1161 @@
+#include "dictionary.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include "exceptions.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+// Nodes come from one pool sized up front for the worst case, every character of the word list being its own node.
+// That makes the whole tree a single allocation, nodes never move while the tree grows, and freeing the tree once it
+// is frozen is a single free. The pool is left uninitialized, so pages of the bound that are never used are never
+// touched either.
+//
+// Children of a node form a sibling list sorted by key.
+class DICTIONARY::PREFIX_TREE
+{
+public:
+	typedef std::uint32_t NODE;
+
+	static constexpr NODE ROOT    = 0;
+	static constexpr NODE NO_NODE = ~NODE(0);
+
+	explicit PREFIX_TREE(std::size_t max_nodes)
+	:
+		m_nodes(),
+		m_num_nodes(0),
+		m_max_nodes(max_nodes),
+		m_total_count(0),
+		m_previous_word(),
+		m_previous_path(1, NODE(ROOT))
+	{
+		if (max_nodes >= NO_NODE)
+		{
+			throw std::length_error("PREFIX_TREE: dictionary too large");
+		}
+		m_nodes.reset(new TREE_NODE[max_nodes]);
+		new_node(0, NO_NODE);
+	}
+
+	// Inserts a word, descending from the deepest node it shares with the previous word instead of from the root.
+	//
+	// For a sorted word list that is the whole fast path: the common prefix costs one compare per character rather than
+	// a sibling search, and each new child is appended right after the previous word's child, which is the current last
+	// child of the node, without scanning the siblings. Nothing has to be declared sorted up front, any word that breaks
+	// the order just takes the ordinary search from the common prefix node.
+	//
+	// The word comes folded (fold_text), its bytes are the keys. Returns false when it was in already; the counts add up.
+	bool add_word(const char * word, std::size_t length, std::uint32_t count)
+	{
+		std::size_t common = 0;
+		const std::size_t common_limit = std::min(length, m_previous_word.size());
+		while (common < common_limit && static_cast<unsigned char>(word[common]) == m_previous_word[common])
+		{
+			++common;
+		}
+
+		// The previous word's child under the common prefix, if it continued past it
+		NODE hint = (common + 1 < m_previous_path.size()) ? m_previous_path[common + 1] : NO_NODE;
+		m_previous_path.resize(common + 1);
+		m_previous_word.resize(common);
+
+		NODE last_node = m_previous_path[common];
+		for (std::size_t pos = common; pos < length; ++pos)
+		{
+			const unsigned char key = static_cast<unsigned char>(word[pos]);
+			last_node = add_or_find_child(last_node, key, hint);
+			hint = NO_NODE;
+			m_previous_path.push_back(last_node);
+			m_previous_word.push_back(key);
+		}
+		TREE_NODE & node = m_nodes[last_node];
+		const bool added = !node.is_word;
+		node.is_word = true;
+		node.count = static_cast<std::uint32_t>(std::min<std::uint64_t>(std::uint64_t(node.count) + count,
+			std::numeric_limits<std::uint32_t>::max()));
+		m_total_count += count;
+		return added;
+	}
+
+	// Unmarks every word counted fewer than min_count times and removes the nodes no word is left below, once all words
+	// are in. Returns how many words went.
+	//
+	// Children come after their parents in the pool, so a backwards pass settles every child before its parent. The
+	// survivors are copied into a new pool in their old order, which keeps that property for equivalence_classes.
+	std::size_t prune(std::uint32_t min_count)
+	{
+		std::size_t removed = 0;
+		std::vector<bool> keep(m_num_nodes, false);
+		for (std::size_t index = m_num_nodes; index-- != 0; )
+		{
+			TREE_NODE & node = m_nodes[index];
+			if (node.is_word && node.count < min_count)
+			{
+				m_total_count -= node.count;
+				node.is_word = false;
+				node.count = 0;
+				++removed;
+			}
+			bool needed = node.is_word || index == ROOT;
+			for (NODE child = node.first_child; child != NO_NODE && !needed; child = m_nodes[child].next_sibling)
+			{
+				needed = keep[child];
+			}
+			keep[index] = needed;
+		}
+
+		std::vector<NODE> renumbered(m_num_nodes, NODE(NO_NODE));
+		std::size_t num_kept = 0;
+		for (std::size_t index = 0; index < m_num_nodes; ++index)
+		{
+			if (keep[index])
+			{
+				renumbered[index] = static_cast<NODE>(num_kept++);
+			}
+		}
+
+		// The first kept node of a sibling list, from `node` on
+		auto kept_from = [&](NODE node)
+		{
+			while (node != NO_NODE && !keep[node])
+			{
+				node = m_nodes[node].next_sibling;
+			}
+			return node == NO_NODE ? NODE(NO_NODE) : renumbered[node];
+		};
+
+		std::unique_ptr<TREE_NODE[]> kept_nodes(new TREE_NODE[std::max<std::size_t>(num_kept, 1)]);
+		for (std::size_t index = 0; index < m_num_nodes; ++index)
+		{
+			if (keep[index])
+			{
+				TREE_NODE & copy = kept_nodes[renumbered[index]];
+				copy = m_nodes[index];
+				copy.first_child = kept_from(m_nodes[index].first_child);
+				copy.next_sibling = kept_from(m_nodes[index].next_sibling);
+			}
+		}
+		m_nodes = std::move(kept_nodes);
+		m_num_nodes = num_kept;
+
+		// add_word's hint points into the old pool
+		m_previous_word.clear();
+		m_previous_path.assign(1, NODE(ROOT));
+		return removed;
+	}
+
+	bool is_word(NODE node) const
+	{
+		return m_nodes[node].is_word;
+	}
+
+	unsigned char key(NODE node) const
+	{
+		return m_nodes[node].key;
+	}
+
+	// Children in key order: first_child, then next_sibling until NO_NODE
+	NODE first_child(NODE node) const
+	{
+		return m_nodes[node].first_child;
+	}
+
+	NODE next_sibling(NODE node) const
+	{
+		return m_nodes[node].next_sibling;
+	}
+
+	std::size_t num_nodes() const
+	{
+		return m_num_nodes;
+	}
+
+	// COST of every word node, from its count relative to the count of all words. Zero for other nodes.
+	std::vector<COST> word_costs() const
+	{
+		std::vector<COST> costs(m_num_nodes, 0);
+		const double log_total = std::log(static_cast<double>(std::max<std::uint64_t>(m_total_count, 1)));
+		for (std::size_t node = 0; node < m_num_nodes; ++node)
+		{
+			if (m_nodes[node].is_word)
+			{
+				const double cost = std::round((log_total - std::log(static_cast<double>(m_nodes[node].count))) * COST_SCALE);
+				costs[node] = static_cast<COST>(std::min<double>(cost, std::numeric_limits<COST>::max()));
+			}
+		}
+		return costs;
+	}
+
+	// Longest path down from every node, i.e. how many more keys the longest word through it has. Children come after
+	// their parent in the pool, so one backward pass has every child's done before its parent needs it.
+	std::vector<std::uint32_t> heights() const
+	{
+		std::vector<std::uint32_t> height(m_num_nodes, 0);
+		for (std::size_t node = m_num_nodes; node-- > 0; )
+		{
+			for (NODE child = m_nodes[node].first_child; child != NO_NODE; child = m_nodes[child].next_sibling)
+			{
+				height[node] = std::max(height[node], height[child] + 1);
+			}
+		}
+		return height;
+	}
+
+	// Maps every node to the representative of its class of equivalent nodes: same is_word and word cost, and the same
+	// keys leading to equivalent children. Equivalent nodes accept the same set of suffixes, so they can share one frozen state,
+	// which is what turns the trie into a minimized DAWG.
+	//
+	// A child is always created after its parent, so walking the pool backwards classifies every child before its
+	// parent, no recursion needed. Classes are found through an open addressing table of representatives.
+	std::vector<NODE> equivalence_classes(const std::vector<COST> & costs) const
+	{
+		std::vector<NODE> class_of(m_num_nodes, NODE(NO_NODE));
+
+		auto hash = [&](NODE node)
+		{
+			std::uint64_t value = m_nodes[node].is_word ? 0x9e3779b97f4a7c15ull ^ costs[node] : 0;
+			for (NODE child = m_nodes[node].first_child; child != NO_NODE; child = m_nodes[child].next_sibling)
+			{
+				value = (value ^ ((std::uint64_t(class_of[child]) << 8) | m_nodes[child].key)) * 0xff51afd7ed558ccdull;
+			}
+			return value ^ (value >> 29);
+		};
+
+		auto equivalent = [&](NODE lhs, NODE rhs)
+		{
+			if (m_nodes[lhs].is_word != m_nodes[rhs].is_word || costs[lhs] != costs[rhs])
+			{
+				return false;
+			}
+			NODE lhs_child = m_nodes[lhs].first_child;
+			NODE rhs_child = m_nodes[rhs].first_child;
+			for (; lhs_child != NO_NODE && rhs_child != NO_NODE;
+				lhs_child = m_nodes[lhs_child].next_sibling, rhs_child = m_nodes[rhs_child].next_sibling)
+			{
+				if (m_nodes[lhs_child].key != m_nodes[rhs_child].key || class_of[lhs_child] != class_of[rhs_child])
+				{
+					return false;
+				}
+			}
+			return lhs_child == rhs_child;
+		};
+
+		std::size_t table_size = 1;
+		while (table_size < 2 * m_num_nodes)
+		{
+			table_size *= 2;
+		}
+		std::vector<NODE> representatives(table_size, NODE(NO_NODE));
+
+		for (std::size_t index = m_num_nodes; index-- != 0; )
+		{
+			const NODE node = static_cast<NODE>(index);
+			std::size_t bucket = static_cast<std::size_t>(hash(node)) & (table_size - 1);
+			while (representatives[bucket] != NO_NODE && !equivalent(representatives[bucket], node))
+			{
+				bucket = (bucket + 1) & (table_size - 1);
+			}
+			if (representatives[bucket] == NO_NODE)
+			{
+				representatives[bucket] = node;
+			}
+			class_of[node] = representatives[bucket];
+		}
+		return class_of;
+	}
+
+private:
+	struct TREE_NODE
+	{
+		NODE first_child;
+		NODE next_sibling;
+		std::uint32_t count;  // Of the word ending here, saturated
+		unsigned char key;
+		bool is_word;
+	};
+
+	NODE new_node(unsigned char key, NODE next_sibling)
+	{
+		// The pool is sized for the worst case, running out means the bound was computed wrong
+		if (m_num_nodes == m_max_nodes)
+		{
+			throw std::logic_error("PREFIX_TREE: node pool exhausted");
+		}
+		TREE_NODE & node = m_nodes[m_num_nodes];
+		node.first_child  = NO_NODE;
+		node.next_sibling = next_sibling;
+		node.count        = 0;
+		node.key          = key;
+		node.is_word      = false;
+		return static_cast<NODE>(m_num_nodes++);
+	}
+
+	// hint is a child of parent or NO_NODE. When it is the last child and sorts before key, the new child goes right
+	// after it.
+	NODE add_or_find_child(NODE parent, unsigned char key, NODE hint)
+	{
+		if (hint != NO_NODE && m_nodes[hint].key < key && m_nodes[hint].next_sibling == NO_NODE)
+		{
+			const NODE added = new_node(key, NO_NODE);
+			m_nodes[hint].next_sibling = added;
+			return added;
+		}
+
+		NODE previous = NO_NODE;
+		NODE child = m_nodes[parent].first_child;
+		while (child != NO_NODE && m_nodes[child].key < key)
+		{
+			previous = child;
+			child = m_nodes[child].next_sibling;
+		}
+		if (child != NO_NODE && m_nodes[child].key == key)
+		{
+			return child;
+		}
+
+		const NODE added = new_node(key, child);
+		if (previous == NO_NODE)
+		{
+			m_nodes[parent].first_child = added;
+		}
+		else
+		{
+			m_nodes[previous].next_sibling = added;
+		}
+		return added;
+	}
+
+	std::unique_ptr<TREE_NODE[]> m_nodes;
+	std::size_t m_num_nodes;
+	const std::size_t m_max_nodes;
+	std::uint64_t m_total_count;
+
+	// Positional hint for the next add_word: the previous word (folded), and the node after each of its characters
+	std::vector<unsigned char> m_previous_word;
+	std::vector<NODE> m_previous_path;
+};
+
+DICTIONARY::DICTIONARY(const char * compiled_filename, MAPPED)
+:
+	m_trie(MAPPED_FILE(compiled_filename))
+{
+
+}
+
+DICTIONARY::DICTIONARY(const EMBEDDED & tables)
+:
+	m_trie(tables)
+{
+
+}
+
+namespace
+{
+	bool is_digit(char c)
+	{
+		return static_cast<unsigned>(static_cast<unsigned char>(c) - '0') < 10u;
+	}
+
+	// Calls on_word(begin, length, count) for every whitespace separated word in [data, data + length).
+	// count is the token of digits that follows the word on the same line, 1 without one.
+	template <typename ON_WORD>
+	void for_each_word(const char * data, std::size_t length, ON_WORD on_word)
+	{
+		const char * const end = data + length;
+		const char * iter = data;
+		for (;;)
+		{
+			while (iter != end && is_space(*iter))
+			{
+				++iter;
+			}
+			if (iter == end)
+			{
+				return;
+			}
+			const char * const word = iter;
+			while (iter != end && !is_space(*iter))
+			{
+				++iter;
+			}
+			const std::size_t word_length = static_cast<std::size_t>(iter - word);
+
+			const char * count_iter = iter;
+			while (count_iter != end && (*count_iter == ' ' || *count_iter == '\t'))
+			{
+				++count_iter;
+			}
+			std::uint64_t count = 0;
+			const char * const count_begin = count_iter;
+			while (count_iter != end && is_digit(*count_iter))
+			{
+				count = std::min<std::uint64_t>(count * 10 + static_cast<unsigned>(*count_iter - '0'), ~std::uint32_t(0));
+				++count_iter;
+			}
+			if (count_iter != count_begin && (count_iter == end || is_space(*count_iter)))
+			{
+				iter = count_iter;
+			}
+			else
+			{
+				count = 1;
+			}
+			on_word(word, word_length, static_cast<std::uint32_t>(count));
+		}
+	}
+}
+
+// Two passes over the mapped word list: the first counts characters to size the node pool, the second builds.
+void DICTIONARY::load(const char * filename, const LOAD_OPTIONS & options)
+{
+	if (options.minimize && options.match_links)
+	{
+		throw std::invalid_argument("DICTIONARY: match links need a plain trie, not a minimized one");
+	}
+	const MAPPED_FILE word_list(filename);
+
+	std::size_t num_chars = 0;
+	for_each_word(word_list.data(), word_list.size(), [&](const char *, std::size_t length, std::uint32_t)
+	{
+		num_chars += length;
+	});
+
+	// The alphabet split into folded code points: its ASCII part as a table, longer code points in a sorted list that a
+	// word's code point must equal as a whole. A substring search would let a stray continuation byte or a lone lead
+	// byte through, since fold_code_point takes either as a code point of its own.
+	bool ascii_allowed[0x80] = {};
+	std::vector<std::string> code_points_allowed;
+	std::string folded_code_point(4, '\0');
+	for (std::size_t pos = 0; pos < options.alphabet.size(); )
+	{
+		bool letter;
+		const std::size_t length = fold_code_point(options.alphabet.data() + pos, options.alphabet.size() - pos,
+			&folded_code_point[0], letter);
+		if (length == 1 && static_cast<unsigned char>(folded_code_point[0]) < 0x80)
+		{
+			ascii_allowed[static_cast<unsigned char>(folded_code_point[0])] = true;
+		}
+		else
+		{
+			code_points_allowed.push_back(folded_code_point.substr(0, length));
+		}
+		pos += length;
+	}
+	std::sort(code_points_allowed.begin(), code_points_allowed.end());
+	auto allowed = [&](const char * folded, std::size_t length, bool letter)
+	{
+		if (options.letters_only && !letter)
+		{
+			return false;
+		}
+		if (options.alphabet.empty())
+		{
+			return true;
+		}
+		return length == 1 && static_cast<unsigned char>(*folded) < 0x80
+			? ascii_allowed[static_cast<unsigned char>(*folded)]
+			: std::binary_search(code_points_allowed.begin(), code_points_allowed.end(), std::string(folded, length));
+	};
+
+	REPORT load_report;
+	PREFIX_TREE prefix_tree(num_chars + 1);
+	std::vector<char> folded;
+	for_each_word(word_list.data(), word_list.size(), [&](const char * word, std::size_t length, std::uint32_t count)
+	{
+		++load_report.tokens;
+		if (count == 0)
+		{
+			// "word<TAB>0" says the word never occurred, its cost would be -ln 0
+			++load_report.filtered_count;
+			return;
+		}
+		folded.resize(length);
+		std::size_t code_points = 0;
+		bool all_allowed = true;
+		for (std::size_t pos = 0; pos < length; ++code_points)
+		{
+			bool letter;
+			const std::size_t code_point = fold_code_point(word + pos, length - pos, folded.data() + pos, letter);
+			all_allowed = all_allowed && allowed(folded.data() + pos, code_point, letter);
+			pos += code_point;
+		}
+
+		if (code_points < options.min_length || (options.max_length != 0 && code_points > options.max_length))
+		{
+			++load_report.filtered_length;
+		}
+		else if (!all_allowed)
+		{
+			++load_report.filtered_alphabet;
+		}
+		else if (!prefix_tree.add_word(folded.data(), length, count))
+		{
+			++load_report.duplicates;
+		}
+	});
+	// Every count is at least 1 by now, so min_count 1 would drop nothing
+	if (options.min_count > 1)
+	{
+		load_report.filtered_count += prefix_tree.prune(options.min_count);
+	}
+	m_trie = DOUBLE_ARRAY_TRIE(prefix_tree, options.minimize, options.match_links);
+	m_load_report = load_report;
+}
+
+DICTIONARY::REPORT::REPORT()
+:
+	tokens(0),
+	duplicates(0),
+	filtered_length(0),
+	filtered_alphabet(0),
+	filtered_count(0),
+	words(0),
+	nodes(0),
+	bytes(0),
+	max_depth(0),
+	average_branching(0)
+{
+
+}
+
+DICTIONARY::REPORT DICTIONARY::report() const
+{
+	REPORT report = m_load_report;
+	report.nodes = num_nodes();
+	report.bytes = byte_size();
+	m_trie.shape(report);
+	return report;
+}
+
+void DICTIONARY::write_report(std::FILE * out, const REPORT & report)
+{
+	std::fprintf(out, "dict_tokens %zu\n",            report.tokens);
+	std::fprintf(out, "dict_duplicates %zu\n",        report.duplicates);
+	std::fprintf(out, "dict_filtered_length %zu\n",   report.filtered_length);
+	std::fprintf(out, "dict_filtered_alphabet %zu\n", report.filtered_alphabet);
+	std::fprintf(out, "dict_filtered_count %zu\n",    report.filtered_count);
+	std::fprintf(out, "dict_words %zu\n",             report.words);
+	std::fprintf(out, "dict_nodes %zu\n",             report.nodes);
+	std::fprintf(out, "dict_bytes %zu\n",             report.bytes);
+	std::fprintf(out, "dict_max_depth %zu\n",         report.max_depth);
+	std::fprintf(out, "dict_average_branching %.3f\n", report.average_branching);
+	std::fflush(out);
+}
+
+void DICTIONARY::save(const char * compiled_filename) const
+{
+	m_trie.save(compiled_filename);
+}
+
+void DICTIONARY::save_header(const char * header_filename, const char * name) const
+{
+	m_trie.save_header(header_filename, name);
+}
+
+namespace
+{
+	// Compiled dictionary layout. All integers are in the byte order of the machine that ran dictc;
+	// byte_order lets a reader on another machine refuse the file instead of misreading it.
+	//
+	//   [0, sizeof(COMPILED_HEADER))       header
+	//   [slots_offset, +8 * num_slots)     slots (unit, label, completion, cost), 64-byte aligned
+	//   [links_offset, +12 * num_slots)    match links (fail, output, depth, cost), 64-byte aligned; links_offset 0 if none
+	struct COMPILED_HEADER
+	{
+		char          magic[8];
+		std::uint32_t version;
+		std::uint32_t byte_order;
+		std::uint64_t num_slots;
+		std::uint64_t num_nodes;
+		std::uint64_t slots_offset;
+		std::uint64_t links_offset;
+		std::uint64_t max_word_length;
+	};
+
+	const char          COMPILED_MAGIC[8]   = { 'S', 'B', 'D', 'I', 'C', 'T', '\0', '\0' };
+	const std::uint32_t COMPILED_VERSION    = 6;  // 6: slots carry their completion, the header the longest word
+	const std::uint32_t COMPILED_BYTE_ORDER = 0x01020304;
+	const std::size_t   COMPILED_ALIGNMENT  = 64;
+
+	std::size_t align_up(std::size_t offset)
+	{
+		return (offset + COMPILED_ALIGNMENT - 1) / COMPILED_ALIGNMENT * COMPILED_ALIGNMENT;
+	}
+}
+
+DICTIONARY::DOUBLE_ARRAY_TRIE::DOUBLE_ARRAY_TRIE()
+:
+	m_slots(nullptr),
+	m_links(nullptr),
+	m_num_slots(0),
+	m_num_nodes(1),
+	m_max_word_length(0),
+	m_slot_storage(KEY_RANGE + 1, TRIE_SLOT()),
+	m_link_storage(),
+	m_mapping()
+{
+	point_at_storage();
+}
+
+DICTIONARY::DOUBLE_ARRAY_TRIE::DOUBLE_ARRAY_TRIE(const PREFIX_TREE & prefix_tree, bool minimize, bool match_links)
+:
+	m_slots(nullptr),
+	m_links(nullptr),
+	m_num_slots(0),
+	m_num_nodes(1),
+	m_max_word_length(0),
+	m_slot_storage(1, TRIE_SLOT()),
+	m_link_storage(),
+	m_mapping()
+{
+	build(prefix_tree, minimize, match_links);
+	point_at_storage();
+}
+
+DICTIONARY::DOUBLE_ARRAY_TRIE::DOUBLE_ARRAY_TRIE(MAPPED_FILE && mapping)
+:
+	m_slots(nullptr),
+	m_links(nullptr),
+	m_num_slots(0),
+	m_num_nodes(0),
+	m_max_word_length(0),
+	m_slot_storage(),
+	m_link_storage(),
+	m_mapping(std::move(mapping))
+{
+	// Only the header is checked, the arrays are trusted to be what dictc wrote. Anything that walks every slot here
+	// would bring back the start up cost that mapping is meant to remove.
+	COMPILED_HEADER header;
+	if (m_mapping.size() < sizeof(header))
+	{
+		throw EXCEPTIONS::BAD_DICTIONARY_FILE_EXCEPTION();
+	}
+	std::memcpy(&header, m_mapping.data(), sizeof(header));
+
+	if (std::memcmp(header.magic, COMPILED_MAGIC, sizeof(COMPILED_MAGIC)) != 0 ||
+		header.version != COMPILED_VERSION ||
+		header.byte_order != COMPILED_BYTE_ORDER ||
+		header.num_slots < KEY_RANGE ||
+		header.num_slots > m_mapping.size() ||
+		header.num_nodes > header.num_slots ||
+		header.slots_offset % alignof(TRIE_SLOT) != 0 ||
+		header.slots_offset + header.num_slots * sizeof(TRIE_SLOT) > m_mapping.size() ||
+		header.links_offset % alignof(MATCH_LINK) != 0 ||
+		(header.links_offset != 0 && header.links_offset + header.num_slots * sizeof(MATCH_LINK) > m_mapping.size()))
+	{
+		throw EXCEPTIONS::BAD_DICTIONARY_FILE_EXCEPTION();
+	}
+
+	m_slots     = reinterpret_cast<const TRIE_SLOT *>(m_mapping.data() + header.slots_offset);
+	m_links     = header.links_offset != 0 ? reinterpret_cast<const MATCH_LINK *>(m_mapping.data() + header.links_offset) : nullptr;
+	m_num_slots = static_cast<std::size_t>(header.num_slots);
+	m_num_nodes = static_cast<std::size_t>(header.num_nodes);
+	m_max_word_length = static_cast<std::size_t>(header.max_word_length);
+}
+
+void DICTIONARY::DOUBLE_ARRAY_TRIE::save(const char * compiled_filename) const
+{
+	COMPILED_HEADER header;
+	std::memcpy(header.magic, COMPILED_MAGIC, sizeof(COMPILED_MAGIC));
+	header.version       = COMPILED_VERSION;
+	header.byte_order    = COMPILED_BYTE_ORDER;
+	header.num_slots     = m_num_slots;
+	header.num_nodes     = m_num_nodes;
+	header.slots_offset  = align_up(sizeof(header));
+	header.links_offset  = m_links != nullptr ? align_up(header.slots_offset + m_num_slots * sizeof(TRIE_SLOT)) : 0;
+	header.max_word_length = m_max_word_length;
+
+	std::ofstream ofs(compiled_filename, std::ios::binary | std::ios::trunc);
+	const char padding[COMPILED_ALIGNMENT] = {};
+	ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	ofs.write(padding, static_cast<std::streamsize>(header.slots_offset - sizeof(header)));
+	ofs.write(reinterpret_cast<const char *>(m_slots), static_cast<std::streamsize>(m_num_slots * sizeof(TRIE_SLOT)));
+	if (m_links != nullptr)
+	{
+		ofs.write(padding, static_cast<std::streamsize>(header.links_offset - header.slots_offset - m_num_slots * sizeof(TRIE_SLOT)));
+		ofs.write(reinterpret_cast<const char *>(m_links), static_cast<std::streamsize>(m_num_slots * sizeof(MATCH_LINK)));
+	}
+	ofs.close();
+	if (!ofs)
+	{
+		throw std::runtime_error(std::string("cannot write ") + compiled_filename);
+	}
+}
+
+DICTIONARY::DOUBLE_ARRAY_TRIE::DOUBLE_ARRAY_TRIE(const EMBEDDED & tables)
+:
+	m_slots(tables.slots),
+	m_links(tables.links),
+	m_num_slots(tables.num_slots),
+	m_num_nodes(tables.num_nodes),
+	m_max_word_length(tables.max_word_length),
+	m_slot_storage(),
+	m_link_storage(),
+	m_mapping()
+{
+
+}
+
+// The slots (and links) go out as aggregate initializers, four to a line. alignas keeps the table on cache line boundaries like
+// the compiled format; constexpr puts it in .rodata with no dynamic initialization.
+void DICTIONARY::DOUBLE_ARRAY_TRIE::save_header(const char * header_filename, const char * name) const
+{
+	std::ofstream ofs(header_filename, std::ios::trunc);
+	ofs << "// Generated by dictc, do not edit: " << m_num_nodes << " nodes, " << byte_size() << " bytes\n"
+		<< "#ifndef SENTENCE_BREAKER_EMBEDDED_" << name << "\n"
+		<< "#define SENTENCE_BREAKER_EMBEDDED_" << name << "\n\n"
+		<< "#include \"dictionary.hpp\"\n\n"
+		<< "namespace SENTENCE_BREAKER\n{\n\nnamespace EMBEDDED_TABLES\n{\n\n"
+		<< "alignas(" << COMPILED_ALIGNMENT << ") constexpr DICTIONARY::TRIE_SLOT " << name << "_slots[] =\n{\n";
+
+	char line[128];
+	for (std::size_t slot = 0; slot < m_num_slots; ++slot)
+	{
+		const TRIE_SLOT & trie_slot = m_slots[slot];
+		const int written = std::snprintf(line, sizeof(line), "%s{0x%xu,%u,%u,%u},", slot % 4 == 0 ? "\t" : "",
+			static_cast<unsigned>(trie_slot.unit), static_cast<unsigned>(trie_slot.label),
+			static_cast<unsigned>(trie_slot.completion), static_cast<unsigned>(trie_slot.cost));
+		ofs.write(line, written);
+		if (slot % 4 == 3 || slot + 1 == m_num_slots)
+		{
+			ofs << '\n';
+		}
+	}
+
+	ofs << "};\n\n";
+
+	if (m_links != nullptr)
+	{
+		ofs << "alignas(" << COMPILED_ALIGNMENT << ") constexpr DICTIONARY::MATCH_LINK " << name << "_links[] =\n{\n";
+		for (std::size_t slot = 0; slot < m_num_slots; ++slot)
+		{
+			const MATCH_LINK & link = m_links[slot];
+			const int written = std::snprintf(line, sizeof(line), "%s{%uu,%uu,%uu,%uu},", slot % 4 == 0 ? "\t" : "",
+				static_cast<unsigned>(link.fail), static_cast<unsigned>(link.output), static_cast<unsigned>(link.depth), static_cast<unsigned>(link.cost));
+			ofs.write(line, written);
+			if (slot % 4 == 3 || slot + 1 == m_num_slots)
+			{
+				ofs << '\n';
+			}
+		}
+		ofs << "};\n\n";
+	}
+
+	ofs << "constexpr DICTIONARY::EMBEDDED " << name << " = { " << name << "_slots, " << m_num_slots << ", " << m_num_nodes
+			<< ", " << (m_links != nullptr ? std::string(name) + "_links" : std::string("nullptr")) << ", " << m_max_word_length
+			<< " };\n\n"
+		<< "} // End Namespace\n\n} // End Namespace\n\n#endif\n";
+	ofs.close();
+	if (!ofs)
+	{
+		throw std::runtime_error(std::string("cannot write ") + header_filename);
+	}
+}
+
+constexpr std::size_t DICTIONARY::BATCH_LANES;
+constexpr unsigned DICTIONARY::COMPLETION_LIMIT;
+
+void DICTIONARY::DOUBLE_ARRAY_TRIE::prefix_match_batch(const std::string * queries, std::size_t count,
+	std::pair<bool, bool> * results) const
+{
+	// One walk in flight. Between turns it holds the slot its pending step lands on, prefetched but not yet checked.
+	struct LANE
+	{
+		std::size_t query;
+		const char * next;            // Input not yet folded
+		const char * end;
+		const TRIE_SLOT * child;      // Where the pending step lands, if its label matches
+		unsigned char key;            // Key of the pending step
+		unsigned char folded_next;    // Rest of a multibyte code point, folded[folded_next, folded_length)
+		unsigned char folded_length;
+		char folded[4];
+	};
+
+	// Folds the next key of the lane's query, the way prefix_match does. False at the end of the query.
+	const auto next_key = [](LANE & lane, unsigned char & key)
+	{
+		if (lane.folded_next < lane.folded_length)
+		{
+			key = static_cast<unsigned char>(lane.folded[lane.folded_next++]);
+			return true;
+		}
+		if (lane.next == lane.end)
+		{
+			return false;
+		}
+		if (static_cast<unsigned char>(*lane.next) < 0x80)
+		{
+			key = static_cast<unsigned char>(fold_ascii(*lane.next++));
+			return true;
+		}
+		bool letter;
+		const std::size_t length = fold_code_point(lane.next, static_cast<std::size_t>(lane.end - lane.next),
+			lane.folded, letter);
+		lane.next += length;
+		lane.folded_length = static_cast<unsigned char>(length);
+		lane.folded_next = 1;
+		key = static_cast<unsigned char>(lane.folded[0]);
+		return true;
+	};
+
+	// Issues the step from `node`, which the lane stands on. False when the walk ends there, its result written.
+	const auto issue = [this, results, &next_key](LANE & lane, const TRIE_SLOT & node)
+	{
+		unsigned char key;
+		if (!next_key(lane, key))
+		{
+			results[lane.query] = std::make_pair(is_word(node), has_children(node));
+			return false;
+		}
+		SENTENCE_BREAKER_COUNT(trie_steps, 1);
+		if (!(node.unit & HAS_CHILDREN_BIT) || key == 0)
+		{
+			results[lane.query] = std::make_pair(false, false);
+			return false;
+		}
+		lane.key = key;
+		lane.child = m_slots + (node.unit & BASE_MASK) + key;
+		__builtin_prefetch(lane.child);
+		return true;
+	};
+
+	// Puts the next query that doesn't end at the root on the lane. False when there is none left.
+	std::size_t next_query = 0;
+	const auto start = [this, queries, count, &next_query, &issue](LANE & lane)
+	{
+		while (next_query < count)
+		{
+			const std::string & query = queries[next_query];
+			lane.query = next_query++;
+			lane.next = query.data();
+			lane.end = query.data() + query.size();
+			lane.folded_next = lane.folded_length = 0;
+			if (issue(lane, *m_slots))
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	LANE lanes[BATCH_LANES];
+	std::size_t active = 0;
+	while (active < BATCH_LANES && start(lanes[active]))
+	{
+		++active;
+	}
+
+	// A lane whose walk ends takes the next query; once none is left, the last active lane fills its place
+	while (active > 0)
+	{
+		for (std::size_t index = 0; index < active; )
+		{
+			LANE & lane = lanes[index];
+			bool in_flight;
+			if (lane.child->label != lane.key)
+			{
+				results[lane.query] = std::make_pair(false, false);
+				in_flight = start(lane);
+			}
+			else
+			{
+				in_flight = issue(lane, *lane.child) || start(lane);
+			}
+
+			if (in_flight)
+			{
+				++index;
+			}
+			else
+			{
+				lane = lanes[--active];
+			}
+		}
+	}
+}
+
+// Depth first with an explicit stack, since a word list may hold a word of any length. A DAWG reaches a node by many
+// paths, so every slot is expanded once and its word count is reused by every later parent: a node is finished once
+// all its children are. The height was recorded at build time.
+void DICTIONARY::DOUBLE_ARRAY_TRIE::shape(REPORT & report) const
+{
+	// Only the keys that label some slot are probed, dozens for a word list rather than 255
+	bool labelled[KEY_RANGE] = {};
+	for (std::size_t slot = 1; slot < m_num_slots; ++slot)
+	{
+		labelled[m_slots[slot].label] = true;
+	}
+	std::vector<unsigned char> keys;
+	for (unsigned key = 1; key < KEY_RANGE; ++key)
+	{
+		if (labelled[key])
+		{
+			keys.push_back(static_cast<unsigned char>(key));
+		}
+	}
+
+	enum : unsigned char { UNSEEN, OPEN, DONE };
+	std::vector<unsigned char> state(m_num_slots, UNSEEN);
+	std::vector<std::uint64_t> words(m_num_slots, 0);
+	std::uint64_t edges = 0, parents = 0;
+
+	std::vector<std::pair<SLOT, std::size_t>> stack;  // Slot and the index of the next key to probe
+	stack.emplace_back(SLOT(ROOT), 0);
+	state[ROOT] = OPEN;
+	while (!stack.empty())
+	{
+		const SLOT slot = stack.back().first;
+		std::size_t & next_key = stack.back().second;
+		if (has_children(slot))
+		{
+			while (next_key < keys.size())
+			{
+				const SLOT child = step(slot, keys[next_key++]);
+				if (child != NO_SLOT && state[child] == UNSEEN)
+				{
+					state[child] = OPEN;
+					stack.emplace_back(child, 0);
+					break;
+				}
+			}
+			if (stack.back().first != slot)
+			{
+				continue;
+			}
+		}
+
+		std::uint64_t slot_words = is_word(slot) ? 1 : 0;
+		if (has_children(slot))
+		{
+			std::uint64_t children = 0;
+			for (const unsigned char key : keys)
+			{
+				const SLOT child = step(slot, key);
+				if (child != NO_SLOT)
+				{
+					++children;
+					slot_words += words[child];
+				}
+			}
+			edges += children;
+			parents += children != 0 ? 1 : 0;
+		}
+		words[slot] = slot_words;
+		state[slot] = DONE;
+		stack.pop_back();
+	}
+
+	report.words = static_cast<std::size_t>(words[ROOT]);
+	report.max_depth = m_max_word_length;
+	report.average_branching = parents != 0 ? static_cast<double>(edges) / static_cast<double>(parents) : 0;
+}
+
+void DICTIONARY::DOUBLE_ARRAY_TRIE::point_at_storage()
+{
+	m_slots     = m_slot_storage.data();
+	m_links     = m_link_storage.empty() ? nullptr : m_link_storage.data();
+	m_num_slots = m_slot_storage.size();
+}
+
+// Places the nodes breadth first, so the top levels that every lookup walks through end up next to each other.
+//
+// When minimizing, only the first node of each equivalence class gets a children block; every other node of the class
+// points its base at that same block. A base still belongs to exactly one block, so the label check stays sufficient.
+//
+// Match links come last, once every slot is placed: the failure target of a node is shallower than the node, so a
+// second breadth first pass over the same queue always finds its links (and its children) ready.
+void DICTIONARY::DOUBLE_ARRAY_TRIE::build(const PREFIX_TREE & prefix_tree, bool minimize, bool match_links)
+{
+	typedef PREFIX_TREE::NODE NODE;
+
+	const std::vector<COST> costs = prefix_tree.word_costs();
+	const std::vector<std::uint32_t> heights = prefix_tree.heights();
+	auto completion = [&](NODE node)
+	{
+		return static_cast<unsigned char>(std::min<std::uint32_t>(heights[node], COMPLETION_LIMIT));
+	};
+	m_max_word_length = heights[PREFIX_TREE::ROOT];
+	const std::vector<NODE> class_of = minimize ? prefix_tree.equivalence_classes(costs) : std::vector<NODE>();
+	std::vector<std::uint32_t> class_base(minimize ? prefix_tree.num_nodes() : 0, 0);  // 0: block not placed yet
+
+	std::vector<bool> used_slots(1, true);
+	std::vector<bool> used_bases;
+	std::size_t search_begin = 1;
+
+	// First-fit search for an unused base at which every child key of the node lands on a free slot.
+	// Regions that turn out to be almost full are skipped by later searches (the same heuristic Darts uses),
+	// otherwise every node would rescan the densely packed front of the arrays.
+	auto find_base = [&](NODE node)
+	{
+		const unsigned char first_key = prefix_tree.key(prefix_tree.first_child(node));
+		std::size_t occupied = 0;
+		for (std::size_t pos = std::max<std::size_t>(search_begin, first_key + 1); ; ++pos)
+		{
+			if (pos >= used_slots.size())
+			{
+				resize(pos + KEY_RANGE, used_slots);
+			}
+			if (used_slots[pos])
+			{
+				++occupied;
+				continue;
+			}
+
+			const std::size_t base = pos - first_key;
+			if (base + KEY_RANGE > used_slots.size())
+			{
+				resize(base + KEY_RANGE, used_slots);
+			}
+			if (base < used_bases.size() && used_bases[base])
+			{
+				continue;
+			}
+
+			bool fits = true;
+			for (NODE child = prefix_tree.first_child(node); child != PREFIX_TREE::NO_NODE; child = prefix_tree.next_sibling(child))
+			{
+				if (used_slots[base + prefix_tree.key(child)])
+				{
+					fits = false;
+					break;
+				}
+			}
+			if (!fits)
+			{
+				continue;
+			}
+
+			if (occupied * 20 >= (pos - search_begin + 1) * 19)
+			{
+				search_begin = pos;
+			}
+			if (base >= used_bases.size())
+			{
+				used_bases.resize(base + 1, false);
+			}
+			return base;
+		}
+	};
+
+	std::vector<std::pair<NODE, SLOT>> queue;
+	queue.reserve(prefix_tree.num_nodes());
+	queue.emplace_back(NODE(PREFIX_TREE::ROOT), SLOT(ROOT));
+	m_slot_storage[ROOT].completion = completion(PREFIX_TREE::ROOT);
+	if (prefix_tree.is_word(PREFIX_TREE::ROOT))
+	{
+		m_slot_storage[ROOT].unit |= IS_WORD_BIT;
+		m_slot_storage[ROOT].cost = costs[PREFIX_TREE::ROOT];
+	}
+
+	for (std::size_t head = 0; head < queue.size(); ++head)
+	{
+		const NODE node = queue[head].first;
+		const SLOT slot = queue[head].second;
+		if (prefix_tree.first_child(node) == PREFIX_TREE::NO_NODE)
+		{
+			continue;
+		}
+
+		if (minimize && class_base[class_of[node]] != 0)
+		{
+			m_slot_storage[slot].unit |= HAS_CHILDREN_BIT | class_base[class_of[node]];
+			continue;
+		}
+
+		const std::size_t base = find_base(node);
+		if (base > BASE_MASK)
+		{
+			throw std::length_error("DOUBLE_ARRAY_TRIE: dictionary too large");
+		}
+		used_bases[base] = true;
+		m_slot_storage[slot].unit |= HAS_CHILDREN_BIT | static_cast<std::uint32_t>(base);
+		if (minimize)
+		{
+			class_base[class_of[node]] = static_cast<std::uint32_t>(base);
+		}
+
+		for (NODE child = prefix_tree.first_child(node); child != PREFIX_TREE::NO_NODE; child = prefix_tree.next_sibling(child))
+		{
+			const SLOT child_slot = static_cast<SLOT>(base + prefix_tree.key(child));
+			used_slots[child_slot] = true;
+			TRIE_SLOT & trie_slot = m_slot_storage[child_slot];
+			trie_slot.unit  = prefix_tree.is_word(child) ? IS_WORD_BIT : 0;
+			trie_slot.label = prefix_tree.key(child);
+			trie_slot.completion = completion(child);
+			trie_slot.cost  = costs[child];
+			queue.emplace_back(child, child_slot);
+			++m_num_nodes;
+		}
+	}
+
+	// Trailing free slots can go, as long as base + any key stays in range
+	std::size_t used_size = used_slots.size();
+	while (used_size > 1 && !used_slots[used_size - 1])
+	{
+		--used_size;
+	}
+	resize(std::max(used_size, used_bases.size() + KEY_RANGE), used_slots);
+	m_slot_storage.shrink_to_fit();
+
+	if (!match_links)
+	{
+		return;
+	}
+
+	auto child_slot = [&](SLOT slot, unsigned char key)
+	{
+		const std::uint32_t unit = m_slot_storage[slot].unit;
+		const SLOT child = (unit & BASE_MASK) + key;
+		return (unit & HAS_CHILDREN_BIT) && m_slot_storage[child].label == key ? child : SLOT(NO_SLOT);
+	};
+
+	m_link_storage.assign(m_slot_storage.size(), MATCH_LINK{ ROOT, NO_SLOT, 0, 0 });
+	for (const std::pair<NODE, SLOT> & entry : queue)
+	{
+		const SLOT slot = entry.second;
+		for (NODE child = prefix_tree.first_child(entry.first); child != PREFIX_TREE::NO_NODE; child = prefix_tree.next_sibling(child))
+		{
+			const unsigned char key = prefix_tree.key(child);
+			const SLOT child_at = child_slot(slot, key);
+
+			SLOT fail = ROOT;
+			if (slot != ROOT)
+			{
+				SLOT suffix = m_link_storage[slot].fail;
+				while ((fail = child_slot(suffix, key)) == NO_SLOT && suffix != ROOT)
+				{
+					suffix = m_link_storage[suffix].fail;
+				}
+				if (fail == NO_SLOT)
+				{
+					fail = ROOT;
+				}
+			}
+
+			MATCH_LINK & link = m_link_storage[child_at];
+			link.fail   = fail;
+			link.output = fail != ROOT && (m_slot_storage[fail].unit & IS_WORD_BIT) ? fail : m_link_storage[fail].output;
+			link.depth  = static_cast<std::uint16_t>(m_link_storage[slot].depth + 1);
+			link.cost   = m_slot_storage[child_at].cost;
+			if (link.depth == 0)
+			{
+				throw std::length_error("DICTIONARY: match links hold words of up to 65535 characters");
+			}
+		}
+	}
+}
+
+void DICTIONARY::DOUBLE_ARRAY_TRIE::resize(std::size_t new_size, std::vector<bool> & used_slots)
+{
+	m_slot_storage.resize(new_size, TRIE_SLOT());
+	used_slots.resize(new_size, false);
+}
+
+} // End Namespace
@@ -0,0 +1,572 @@
+#ifndef SENTENCE_BREAKER_DICTIONARY_HPP
+#define SENTENCE_BREAKER_DICTIONARY_HPP
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include "mapped_file.hpp"
+#include "normalize.hpp"
+#include "stats.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+// Dictionary class that quickly finds out whether a sequence of characters represents an English word, or the prefix of an English word,
+// or both
+// Implementation with a prefix tree, which allows linear time prefix feasibility test and low memory footprint
+// (Memory: O(width * height), width is no more than 26 and height is the number of characters of an average english word - 5 to 10 maybe?).
+//
+// The prefix tree is only used while loading. Once all words are in, it is frozen into a double-array trie (two flat arrays)
+// and thrown away, so lookups never touch a per-node heap allocation.
+//
+// Optionally the frozen trie is minimized: nodes that accept the same suffixes ("-ing", "-ness", ...) share one
+// children block, which makes it a DAWG with the same lookups and a fraction of the memory.
+//
+// The frozen trie can be saved as a compiled dictionary (see tools/dictc.cpp) and later served straight from a read-only
+// mapping of that file, which makes start up O(1) and lets every process on a host share the same physical pages.
+class DICTIONARY
+{
+public:
+	// Tag for the constructor that maps a compiled dictionary instead of parsing a word list
+	struct MAPPED
+	{
+
+	};
+
+	// Cost of a word, -ln of its relative frequency in fixed point (COST_SCALE units per nat), rounded and capped.
+	// Words without a count in the word list count once. The unigram engine picks the split of lowest total cost.
+	typedef std::uint16_t COST;
+	static constexpr unsigned COST_SCALE = 256;
+
+	// One slot of the frozen trie, see DOUBLE_ARRAY_TRIE. Public for the tables dictc --header generates.
+	struct TRIE_SLOT
+	{
+		std::uint32_t unit;
+		unsigned char label;
+		unsigned char completion;  // See CURSOR::completion
+		COST cost;
+	};
+
+	// Largest TRIE_SLOT::completion; a slot whose longest word runs on further still says this much
+	static constexpr unsigned COMPLETION_LIMIT = 255;
+
+	// Aho-Corasick links of a slot, see LOAD_OPTIONS::match_links and SCANNER
+	struct MATCH_LINK
+	{
+		std::uint32_t fail;    // Slot of the longest proper suffix of this slot's prefix that is in the trie
+		std::uint32_t output;  // Slot of the longest proper suffix that is a word, NO_SLOT if none
+		std::uint16_t depth;   // Length of this slot's prefix
+		COST cost;             // The slot's own word cost, so an output chain never touches the slots
+	};
+
+	// Static slot tables, as generated by dictc --header into .rodata
+	struct EMBEDDED
+	{
+		const TRIE_SLOT * slots;
+		std::size_t num_slots;
+		std::size_t num_nodes;
+		const MATCH_LINK * links;  // One per slot, or nullptr
+		std::size_t max_word_length;
+	};
+
+	struct LOAD_OPTIONS
+	{
+		LOAD_OPTIONS()
+		:
+			minimize(false),
+			match_links(false),
+			min_length(0),
+			max_length(0),
+			letters_only(false),
+			alphabet(),
+			min_count(0)
+		{
+
+		}
+
+		// Share common suffixes between words (a minimized DAWG) instead of storing the plain trie. Lookups are the same,
+		// memory is a fraction on natural language word lists, at the cost of a longer load.
+		bool minimize;
+
+		// Also build failure and output links (12 bytes a slot), so one SCANNER pass over a text finds every word in it
+		// and the lattice engines stop restarting a trie walk at every position. Only a plain trie has them: a DAWG
+		// state stands for many prefixes, so it has no single failure link. load() throws std::invalid_argument when
+		// both are asked for.
+		//
+		// On an English word list and corpus the scan takes about a third of the trie steps, but is no faster so far:
+		// a failure hop is a chain of dependent loads (unit, label, link) where a restarted walk mostly stays on the hot
+		// top levels of the trie, and the links more than double the memory. Measure with BM_BreakSentence_MatchLinks
+		// before turning them on.
+		bool match_links;
+
+		// Filters, all off by default. A word that one of them drops is not in the trie at all and its count not in
+		// the total the costs are relative to. See REPORT for how many each dropped.
+		//
+		// Lengths are in code points; max_length 0 means no limit.
+		std::size_t min_length;
+		std::size_t max_length;
+
+		// Drops words with a code point that fold_code_point doesn't class as a letter ("don't", "3rd", "e-mail"):
+		// the engines only look up runs of letters, so such a word could never be found in a token anyway.
+		bool letters_only;
+
+		// When not empty, the code points a word may consist of, e.g. "abcdefghijklmnopqrstuvwxyz" to keep a mixed list
+		// to plain English. Compared folded, so it needn't list upper case.
+		std::string alphabet;
+
+		// Drops words whose count, summed over the duplicates and case variants that fold to them, is below this
+		std::uint32_t min_count;
+	};
+
+	// What load() read and dropped, and the shape of the frozen trie, e.g. to size memory per dictionary and to bound
+	// how far the engines look ahead. See report() and write_report().
+	struct REPORT
+	{
+		REPORT();
+
+		// From load(). Zero for compiled and embedded dictionaries: dictc filtered those when it loaded them.
+		std::size_t tokens;             // Words in the word list, duplicates included
+		std::size_t duplicates;         // Folded to a word already in, their counts added to it
+		std::size_t filtered_length;    // Dropped by min_length and max_length
+		std::size_t filtered_alphabet;  // Dropped by letters_only and alphabet
+		std::size_t filtered_count;     // Dropped by min_count once duplicates were merged, plus tokens counted 0
+
+		// From the frozen trie, whatever it was loaded from
+		std::size_t words;              // Distinct words it accepts
+		std::size_t nodes;              // num_nodes()
+		std::size_t bytes;              // byte_size()
+		std::size_t max_depth;          // Trie levels, i.e. max_word_length()
+		double average_branching;       // Children per node that has any
+	};
+
+	// A dictionary file that could be useful: http://www-01.sil.org/linguistics/wordlists/english/wordlist/wordsEn.txt
+	// Just over 1 megabyte, most computers should handle.
+	//
+	// Words are separated by whitespace. A token of digits right after a word on the same line ("word<TAB>count") is
+	// the word's count, counts of words that fold to the same key add up; a token counted 0 is dropped. Words are
+	// UTF-8 (ASCII being a part of it) and folded per code point, see fold_code_point; the trie steps on their bytes,
+	// so keys stay 8 bits and a non-English list costs a few more nodes per word rather than wider ones.
+	DICTIONARY(const char * filename, const LOAD_OPTIONS & options = LOAD_OPTIONS())
+	{
+		load(filename, options);
+	}
+
+	// Serves a file written by save() (or dictc) from mapped memory; nothing is parsed or copied.
+	// Throws EXCEPTIONS::BAD_DICTIONARY_FILE_EXCEPTION when the file is not a compiled dictionary this build understands.
+	DICTIONARY(const char * compiled_filename, MAPPED);
+
+	// Serves tables compiled into the program: no I/O at all, nothing is parsed, copied or checked.
+	explicit DICTIONARY(const EMBEDDED & tables);
+
+	// Read comment for DOUBLE_ARRAY_TRIE::prefix_match
+	std::pair<bool, bool> prefix_match(std::string::const_iterator begin_prefix, std::string::const_iterator end_prefix) const
+	{
+		return m_trie.prefix_match(begin_prefix, end_prefix);
+	}
+
+	// Walks interleaved per DOUBLE_ARRAY_TRIE::prefix_match_batch
+	static constexpr std::size_t BATCH_LANES = 16;
+
+	// prefix_match of every query at once: results[i] is prefix_match(queries[i].cbegin(), queries[i].cend()).
+	// Read comment for DOUBLE_ARRAY_TRIE::prefix_match_batch
+	void prefix_match_batch(const std::string * queries, std::size_t count, std::pair<bool, bool> * results) const
+	{
+		m_trie.prefix_match_batch(queries, count, results);
+	}
+
+	// Replaces the contents of the dictionary with the words in the file. Throws std::system_error if it cannot be opened.
+	void load(const char * filename, const LOAD_OPTIONS & options = LOAD_OPTIONS());
+
+	// Writes the frozen trie in the compiled, mappable format.
+	void save(const char * compiled_filename) const;
+
+	// Writes the frozen trie as a C++ header that defines `constexpr DICTIONARY::EMBEDDED name` (and its slot array)
+	// in namespace SENTENCE_BREAKER::EMBEDDED_TABLES, for DICTIONARY(const EMBEDDED &).
+	void save_header(const char * header_filename, const char * name) const;
+
+	// Trie nodes in use: one per word prefix in a plain trie, one per transition between shared states in a DAWG.
+	std::size_t num_nodes() const
+	{
+		return m_trie.num_nodes();
+	}
+
+	// Memory the frozen trie occupies (or maps), free slots of the double array included
+	std::size_t byte_size() const
+	{
+		return m_trie.byte_size();
+	}
+
+	// Bytes of the longest word, folded. No word found from some position reaches further than this past it, which is
+	// what bounds how far the engines walk ahead of a position and how wide the overlap of a parallel split must be.
+	// Recorded when the trie is frozen, so it costs nothing to ask.
+	std::size_t max_word_length() const
+	{
+		return m_trie.max_word_length();
+	}
+
+	// Walks the frozen trie once, visiting each node once (a DAWG's included), so it takes about as long as a load
+	REPORT report() const;
+
+	// One "dict_<name> value" line per field
+	static void write_report(std::FILE * out, const REPORT & report);
+
+	// Whether SCANNER can be used, see LOAD_OPTIONS::match_links
+	bool has_match_links() const
+	{
+		return m_trie.has_match_links();
+	}
+
+private:
+	// Mutable tree of characters, only alive while a dictionary is being loaded.
+	class PREFIX_TREE;
+
+	// Frozen, read-only form of a PREFIX_TREE laid out as a double-array trie.
+	//
+	// Every tree node owns one 8 byte slot:
+	//   unit:  bit 31     - the characters leading to this slot spell a word
+	//          bit 30     - the node has children
+	//          bits 0..29 - base, the offset of the node's children block
+	//   label: the key that leads into the slot (the "check" array)
+	//   completion: how many more bytes the longest word through the slot has, capped at COMPLETION_LIMIT
+	//   cost:  the word's cost, see DICTIONARY::COST
+	// Unit, label and cost of a slot share a cache line, so a step brings in everything the engines read about the
+	// child, its check and its weight included, with one miss.
+	// The child of a node on key c lives at slot base + c. No two nodes share a base, so a slot whose label is c can
+	// only be the child of the node whose base is slot - c, and the label alone is a sufficient check.
+	// The arrays are padded past the largest base, so a step never needs a bounds check.
+	//
+	// A bitmap indexed layout (a 26 bit child mask and a first child index per node, the child found by popcount) was
+	// tried as the replacement, and is kept as BM_PrefixMatch_Bitmap in bench/bench.cpp to re-measure. Both layouts
+	// plain and both minimized, on a 300k word English list, with the POPCNT instruction: lookups 4 to 9% slower
+	// plain and 14 to 25% slower minimized, 1.7 to 2.4 times slower with a portable popcount. The popcount sits
+	// between the load of a node and the load of its child, where here the next load only waits on the base. Sizes
+	// came out within 2% of each other either way (8.7 MB plain, 2.8 MB minimized), but the bitmap node has no room
+	// for the cost and completion a slot here carries, and it only covers a-z where the labels here are any byte.
+	//
+	// The slots are either owned, or borrowed from the mapping of a compiled dictionary or from embedded tables.
+	//
+	// The build places nodes breadth first, which packs the first level into the root's block and keeps the levels
+	// every lookup walks through next to each other. A dense 26x26 copy of the second level for CURSOR was tried on
+	// top and dropped: segmentation times with and without it stayed within run to run noise. A van Emde Boas order
+	// was not tried: the double array places a node by its parent's base, not by the order the nodes are visited in.
+	class DOUBLE_ARRAY_TRIE
+	{
+	public:
+		typedef std::uint32_t SLOT;
+
+		static constexpr SLOT ROOT    = 0;
+		static constexpr SLOT NO_SLOT = ~SLOT(0);
+
+		DOUBLE_ARRAY_TRIE();
+
+		DOUBLE_ARRAY_TRIE(const PREFIX_TREE & prefix_tree, bool minimize, bool match_links);
+
+		// Borrows the slots of a compiled dictionary inside the mapping, which the trie keeps alive.
+		explicit DOUBLE_ARRAY_TRIE(MAPPED_FILE && mapping);
+
+		// Borrows static tables
+		explicit DOUBLE_ARRAY_TRIE(const EMBEDDED & tables);
+
+		DOUBLE_ARRAY_TRIE(DOUBLE_ARRAY_TRIE &&) = default;
+		DOUBLE_ARRAY_TRIE & operator=(DOUBLE_ARRAY_TRIE &&) = default;
+
+		// Returns the slot reached from `slot` on an already folded key, or NO_SLOT when there is no such child.
+		SLOT step(SLOT slot, unsigned char key) const
+		{
+			SENTENCE_BREAKER_COUNT(trie_steps, 1);
+			const std::uint32_t unit = m_slots[slot].unit;
+			const SLOT child = (unit & BASE_MASK) + key;
+			if (!(unit & HAS_CHILDREN_BIT) || key == 0 || m_slots[child].label != key)
+			{
+				return NO_SLOT;
+			}
+			return child;
+		}
+
+		bool is_word(SLOT slot) const
+		{
+			return is_word(m_slots[slot]);
+		}
+
+		bool has_children(SLOT slot) const
+		{
+			return has_children(m_slots[slot]);
+		}
+
+		// The same two on a slot itself, for walks that hold on to the slot (prefix_match_batch)
+		static bool is_word(const TRIE_SLOT & node)
+		{
+			return (node.unit & IS_WORD_BIT) != 0;
+		}
+
+		static bool has_children(const TRIE_SLOT & node)
+		{
+			return (node.unit & HAS_CHILDREN_BIT) != 0;
+		}
+
+		// Only meaningful when is_word(slot)
+		COST cost(SLOT slot) const
+		{
+			return m_slots[slot].cost;
+		}
+
+		// See CURSOR::completion
+		unsigned completion(SLOT slot) const
+		{
+			return m_slots[slot].completion;
+		}
+
+		bool has_match_links() const
+		{
+			return m_links != nullptr;
+		}
+
+		// Aho-Corasick transition: the slot of the longest suffix of slot's prefix + key that is in the trie.
+		// Amortized constant, only with match links.
+		SLOT scan_step(SLOT slot, unsigned char key) const
+		{
+			for (;;)
+			{
+				const SLOT child = step(slot, key);
+				if (child != NO_SLOT)
+				{
+					return child;
+				}
+				if (slot == ROOT)
+				{
+					return ROOT;
+				}
+				slot = m_links[slot].fail;
+			}
+		}
+
+		const MATCH_LINK & link(SLOT slot) const
+		{
+			return m_links[slot];
+		}
+
+		// Match prefix to words in a dictionary represented by tree of characters (prefix as root),
+		// This implementation would be quick to determine the following two boolean return values that caller needs.
+		//
+		// Returns: bool 1: whether this substring is a word
+		//          bool 2: whether this substring is a prefix of one or more other words, excluding the substring itself
+		//
+		// A worthy optimization: Could take a hint iterator to limit the search to a subtree to speed up the search.
+		// Oftentimes we know which subtree we should look at (e.g. when we want to test whether “apple” is a word after knowing
+		//  “appl” is a prefix but not a word - we should just start from the “l” node instead of redundantly going through
+		// the a-p-p-l-e path). DICTIONARY::CURSOR does exactly that.
+		//
+		// * Input case insensitive, folded per UTF-8 code point like the words were (see fold_code_point).
+		//
+		// Complexity: O of length of character sequence under test.
+		//    Each byte is one add, a load and a compare - no search under a tree node.
+		std::pair<bool, bool> prefix_match(std::string::const_iterator begin_prefix, std::string::const_iterator end_prefix) const
+		{
+			SLOT slot = ROOT;
+			for (auto iter = begin_prefix; iter != end_prefix && slot != NO_SLOT; )
+			{
+				if (static_cast<unsigned char>(*iter) < 0x80)
+				{
+					slot = step(slot, static_cast<unsigned char>(fold_ascii(*iter)));
+					++iter;
+					continue;
+				}
+
+				char folded[4];
+				bool letter;
+				const std::size_t length = fold_code_point(&*iter, static_cast<std::size_t>(end_prefix - iter), folded, letter);
+				for (std::size_t byte = 0; byte < length && slot != NO_SLOT; ++byte)
+				{
+					slot = step(slot, static_cast<unsigned char>(folded[byte]));
+				}
+				iter += static_cast<std::ptrdiff_t>(length);
+			}
+			if (slot == NO_SLOT)
+			{
+				return std::make_pair(false, false);
+			}
+			return std::make_pair(is_word(slot), has_children(slot));
+		}
+
+		// prefix_match over a batch of queries, BATCH_LANES walks at a time in lockstep. Each turn of a walk checks the
+		// slot its previous turn prefetched and issues the prefetch of the next, so by the time the walk comes round
+		// again the other lanes' turns have hidden the load. One walk alone is a chain of dependent loads that waits
+		// out every miss in turn; interleaved, the misses of unrelated queries overlap. A finished lane takes the next
+		// query right away, so short and long queries mix without idle lanes.
+		void prefix_match_batch(const std::string * queries, std::size_t count, std::pair<bool, bool> * results) const;
+
+		// Writes the compiled form, see dictionary.cpp for the layout
+		void save(const char * compiled_filename) const;
+
+		void save_header(const char * header_filename, const char * name) const;
+
+		std::size_t num_nodes() const
+		{
+			return m_num_nodes;
+		}
+
+		std::size_t byte_size() const
+		{
+			return m_num_slots * (sizeof(TRIE_SLOT) + (m_links != nullptr ? sizeof(MATCH_LINK) : 0));
+		}
+
+		std::size_t max_word_length() const
+		{
+			return m_max_word_length;
+		}
+
+		// Fills the trie fields of report other than nodes and bytes
+		void shape(REPORT & report) const;
+
+	private:
+		static constexpr std::uint32_t IS_WORD_BIT      = std::uint32_t(1) << 31;
+		static constexpr std::uint32_t HAS_CHILDREN_BIT = std::uint32_t(1) << 30;
+		static constexpr std::uint32_t BASE_MASK        = HAS_CHILDREN_BIT - 1;
+		static constexpr std::size_t   KEY_RANGE        = 256;
+
+		void build(const PREFIX_TREE & prefix_tree, bool minimize, bool match_links);
+		void resize(std::size_t new_size, std::vector<bool> & used_slots);
+		void point_at_storage();
+
+		// View used by lookups
+		const TRIE_SLOT * m_slots;
+		const MATCH_LINK * m_links;  // nullptr without match links
+		std::size_t m_num_slots;
+		std::size_t m_num_nodes;
+		std::size_t m_max_word_length;
+
+		// Backing memory of the view: the storage vectors, or the mapping, or neither for embedded tables
+		std::vector<TRIE_SLOT> m_slot_storage;
+		std::vector<MATCH_LINK> m_link_storage;
+		MAPPED_FILE m_mapping;
+	};
+
+public:
+	// Resumable prefix_match, i.e. the hint iterator described at DOUBLE_ARRAY_TRIE::prefix_match.
+	// The cursor remembers the trie slot of the characters fed so far, so testing “apple” after “appl” is one step from
+	// the “l” node instead of a walk from the root.
+	//
+	// A cursor is two words and only reads the dictionary; copy it freely, but don't let it outlive the dictionary.
+	class CURSOR
+	{
+	public:
+		explicit CURSOR(const DICTIONARY & dict)
+		:
+			m_trie(&dict.m_trie),
+			m_slot(DOUBLE_ARRAY_TRIE::ROOT)
+		{
+
+		}
+
+		// Appends one character to the prefix under test.
+		// Returns the same pair that prefix_match would for every character fed since construction or the last reset().
+		// Once the prefix falls off the trie, every further advance returns (false, false).
+		//
+		// Unlike prefix_match, the cursor does not fold case: c must already be folded (fold_and_classify does that
+		// for a whole token at once), which keeps the per character work down to the trie step.
+		std::pair<bool, bool> advance(char c)
+		{
+			if (m_slot != DOUBLE_ARRAY_TRIE::NO_SLOT)
+			{
+				m_slot = m_trie->step(m_slot, static_cast<unsigned char>(c));
+			}
+			if (m_slot == DOUBLE_ARRAY_TRIE::NO_SLOT)
+			{
+				return std::make_pair(false, false);
+			}
+			return std::make_pair(m_trie->is_word(m_slot), m_trie->has_children(m_slot));
+		}
+
+		// Cost of the word spelled by the characters fed so far, when the last advance said it is one
+		COST cost() const
+		{
+			return m_trie->cost(m_slot);
+		}
+
+		// How many more characters the longest word that starts with the prefix fed so far has: no word found by
+		// advancing further ends more than this past the prefix. 0 when no longer word does, or once the prefix fell off.
+		// COMPLETION_LIMIT only bounds it from below, the longest word may run on past that.
+		unsigned completion() const
+		{
+			return m_slot != DOUBLE_ARRAY_TRIE::NO_SLOT ? m_trie->completion(m_slot) : 0;
+		}
+
+		// Back to the empty prefix
+		void reset()
+		{
+			m_slot = DOUBLE_ARRAY_TRIE::ROOT;
+		}
+
+	private:
+		const DOUBLE_ARRAY_TRIE * m_trie;
+		DOUBLE_ARRAY_TRIE::SLOT m_slot;
+	};
+
+	CURSOR cursor() const
+	{
+		return CURSOR(*this);
+	}
+
+	// Multi-start matching over the match links (Aho-Corasick): fed a text one folded character at a time, it reports
+	// every dictionary word that ends at the character just fed, wherever it starts. A whole text costs O(length +
+	// matches) trie steps, against a walk from every start position with CURSORs. Requires has_match_links().
+	class SCANNER
+	{
+	public:
+		explicit SCANNER(const DICTIONARY & dict)
+		:
+			m_trie(&dict.m_trie),
+			m_slot(DOUBLE_ARRAY_TRIE::ROOT)
+		{
+
+		}
+
+		void advance(char c)
+		{
+			m_slot = m_trie->scan_step(m_slot, static_cast<unsigned char>(c));
+		}
+
+		// Calls on_word(length, cost) for every word ending at the last character fed, longest first
+		template <typename ON_WORD>
+		void for_each_word(ON_WORD on_word) const
+		{
+			const MATCH_LINK * link = &m_trie->link(m_slot);
+			if (m_trie->is_word(m_slot))
+			{
+				on_word(static_cast<std::size_t>(link->depth), link->cost);
+			}
+			while (link->output != DOUBLE_ARRAY_TRIE::NO_SLOT)
+			{
+				link = &m_trie->link(link->output);
+				on_word(static_cast<std::size_t>(link->depth), link->cost);
+			}
+		}
+
+		// Back to the start of a text
+		void reset()
+		{
+			m_slot = DOUBLE_ARRAY_TRIE::ROOT;
+		}
+
+	private:
+		const DOUBLE_ARRAY_TRIE * m_trie;
+		DOUBLE_ARRAY_TRIE::SLOT m_slot;
+	};
+
+	SCANNER scanner() const
+	{
+		return SCANNER(*this);
+	}
+
+private:
+	// Data Members
+	DOUBLE_ARRAY_TRIE m_trie;
+	REPORT m_load_report;  // The load() fields only
+};
+
+} // End Namespace
+
+#endif
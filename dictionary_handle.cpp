@@ -0,0 +1,185 @@
+#include "dictionary_handle.hpp"
+
+#include <chrono>
+
+namespace SENTENCE_BREAKER
+{
+
+constexpr unsigned DICTIONARY_HANDLE::RECLAIM_INTERVAL_MS;
+
+DICTIONARY_HANDLE::DICTIONARY_HANDLE(std::unique_ptr<DICTIONARY> initial)
+:
+	m_current(initial.release()),
+	m_epoch(1),
+	m_version(0),
+	m_mutex(),
+	m_condition(),
+	m_slots(),
+	m_retired(),
+	m_loaders(),
+	m_reload_error(),
+	m_stopping(false),
+	m_background()
+{
+	m_background = std::thread(&DICTIONARY_HANDLE::background_main, this);
+}
+
+DICTIONARY_HANDLE::~DICTIONARY_HANDLE()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+	m_background.join();
+	delete m_current.load();
+}
+
+DICTIONARY_HANDLE::READER::~READER()
+{
+	if (m_slot != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(m_handle->m_mutex);
+		m_slot->in_use = false;
+	}
+}
+
+DICTIONARY_HANDLE::READER DICTIONARY_HANDLE::reader()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto & slot : m_slots)
+	{
+		if (!slot->in_use)
+		{
+			slot->in_use = true;
+			return READER(this, slot.get());
+		}
+	}
+	m_slots.emplace_back(new READER_SLOT());
+	m_slots.back()->epoch.store(0);
+	m_slots.back()->in_use = true;
+	return READER(this, m_slots.back().get());
+}
+
+// The old dictionary is retired with the epoch that starts after the swap. A snapshot entered in that epoch or later
+// read the pointer after the swap, so only snapshots of earlier epochs can hold the old one.
+//
+// That rests on the single total order of seq_cst operations, which every access below and in READER::acquire and
+// reclaim takes part in:
+// - Here the pointer exchange is sequenced before the epoch increment, so it comes first in the order.
+// - acquire loads the epoch, then stores it to its slot, then loads the pointer. If its load saw the new epoch, the
+//   increment and so the exchange come before its pointer load, which therefore returns the replacement. With a
+//   relaxed (or acquire only) epoch load nothing orders the pointer load after the exchange, and on ARM or POWER a
+//   reader could see the new epoch with the old pointer, which reclaim would then free under it.
+// - reclaim runs after this publish (m_mutex), so its load of a slot either comes after the reader's store in the
+//   order and sees the reader's epoch, or comes before it, in which case the reader's pointer load comes after the
+//   exchange too and it holds the replacement.
+// - A snapshot's release store of 0 is read by reclaim's load, so everything the reader did with the dictionary
+//   happens before it is freed.
+void DICTIONARY_HANDLE::publish(std::unique_ptr<DICTIONARY> replacement)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const DICTIONARY * const old = m_current.exchange(replacement.release(), std::memory_order_seq_cst);
+	const std::uint64_t epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+	m_version.fetch_add(1, std::memory_order_relaxed);
+	m_retired.push_back(RETIRED{ std::unique_ptr<const DICTIONARY>(old), epoch });
+	m_condition.notify_all();
+}
+
+void DICTIONARY_HANDLE::reload(LOADER loader)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_loaders.push_back(std::move(loader));
+	m_condition.notify_all();
+}
+
+std::exception_ptr DICTIONARY_HANDLE::last_reload_error() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_reload_error;
+}
+
+std::size_t DICTIONARY_HANDLE::num_retired() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_retired.size();
+}
+
+void DICTIONARY_HANDLE::background_main()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		reclaim();
+		if (m_stopping)
+		{
+			return;
+		}
+
+		if (!m_loaders.empty())
+		{
+			LOADER loader = std::move(m_loaders.front());
+			m_loaders.erase(m_loaders.begin());
+
+			// Loading takes long, readers and publishers must not wait for it
+			lock.unlock();
+			std::unique_ptr<DICTIONARY> replacement;
+			std::exception_ptr error;
+			try
+			{
+				replacement = loader();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			if (replacement)
+			{
+				publish(std::move(replacement));
+			}
+			lock.lock();
+			m_reload_error = error;
+			continue;
+		}
+
+		if (m_retired.empty())
+		{
+			m_condition.wait(lock);
+		}
+		else
+		{
+			m_condition.wait_for(lock, std::chrono::milliseconds(RECLAIM_INTERVAL_MS));
+		}
+	}
+}
+
+void DICTIONARY_HANDLE::reclaim()
+{
+	if (m_retired.empty())
+	{
+		return;
+	}
+
+	// Oldest epoch a snapshot is still in
+	std::uint64_t oldest = ~std::uint64_t(0);
+	for (const auto & slot : m_slots)
+	{
+		const std::uint64_t epoch = slot->epoch.load(std::memory_order_seq_cst);
+		if (epoch != 0 && epoch < oldest)
+		{
+			oldest = epoch;
+		}
+	}
+
+	std::size_t kept = 0;
+	for (std::size_t index = 0; index < m_retired.size(); ++index)
+	{
+		if (m_retired[index].epoch > oldest)
+		{
+			m_retired[kept++] = std::move(m_retired[index]);
+		}
+	}
+	m_retired.resize(kept);
+}
+
+} // End Namespace
@@ -0,0 +1,199 @@
+#ifndef SENTENCE_BREAKER_DICTIONARY_HANDLE_HPP
+#define SENTENCE_BREAKER_DICTIONARY_HANDLE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "dictionary.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+// A DICTIONARY that can be replaced while segmentation threads keep using it (RCU style).
+//
+// Readers take a SNAPSHOT, which pins the dictionary that was current at that moment. Taking and dropping a snapshot
+// is a handful of atomic loads and stores on the reader's own cache line: no mutex, no reference count shared between
+// threads, and nothing a reader could ever wait on. Publishing a replacement swaps one pointer; the old dictionary is
+// retired and freed by the handle's background thread once no snapshot can still point at it (epoch based
+// reclamation).
+//
+// Every thread that reads gets its own READER once, up front (creating one takes a mutex), and then takes its
+// snapshots from it, one at a time:
+//
+//   DICTIONARY_HANDLE::READER reader = handle.reader();
+//   for (...)
+//   {
+//       DICTIONARY_HANDLE::SNAPSHOT dict = reader.acquire();
+//       break_sentence(words, sentence, *dict);
+//   }
+class DICTIONARY_HANDLE
+{
+private:
+	// Epoch a reader entered its snapshot in, 0 when it holds none. Padded so that readers don't share a cache line.
+	struct READER_SLOT
+	{
+		std::atomic<std::uint64_t> epoch;
+		bool in_use;  // Guarded by m_mutex
+		char padding[64];
+	};
+
+public:
+	typedef std::function<std::unique_ptr<DICTIONARY>()> LOADER;
+
+	class SNAPSHOT
+	{
+	public:
+		SNAPSHOT(SNAPSHOT && other) noexcept
+		:
+			m_slot(other.m_slot),
+			m_dict(other.m_dict)
+		{
+			other.m_slot = nullptr;
+		}
+
+		SNAPSHOT(const SNAPSHOT &) = delete;
+		SNAPSHOT & operator=(const SNAPSHOT &) = delete;
+		SNAPSHOT & operator=(SNAPSHOT &&) = delete;
+
+		~SNAPSHOT()
+		{
+			if (m_slot != nullptr)
+			{
+				m_slot->epoch.store(0, std::memory_order_release);
+			}
+		}
+
+		const DICTIONARY & operator*() const
+		{
+			return *m_dict;
+		}
+
+		const DICTIONARY * operator->() const
+		{
+			return m_dict;
+		}
+
+	private:
+		friend class DICTIONARY_HANDLE;
+
+		SNAPSHOT(READER_SLOT * slot, const DICTIONARY * dict)
+		:
+			m_slot(slot),
+			m_dict(dict)
+		{
+
+		}
+
+		READER_SLOT * m_slot;
+		const DICTIONARY * m_dict;
+	};
+
+	// One thread's access to the handle. Holds at most one snapshot at a time, and must not outlive the handle.
+	class READER
+	{
+	public:
+		READER(READER && other) noexcept
+		:
+			m_handle(other.m_handle),
+			m_slot(other.m_slot)
+		{
+			other.m_slot = nullptr;
+		}
+
+		READER(const READER &) = delete;
+		READER & operator=(const READER &) = delete;
+		READER & operator=(READER &&) = delete;
+
+		~READER();
+
+		// The current dictionary, pinned until the snapshot is destroyed. Never blocks.
+		SNAPSHOT acquire()
+		{
+			// All three are seq_cst, see DICTIONARY_HANDLE::publish for why none of them may be weaker
+			m_slot->epoch.store(m_handle->m_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+			return SNAPSHOT(m_slot, m_handle->m_current.load(std::memory_order_seq_cst));
+		}
+
+	private:
+		friend class DICTIONARY_HANDLE;
+
+		READER(DICTIONARY_HANDLE * handle, READER_SLOT * slot)
+		:
+			m_handle(handle),
+			m_slot(slot)
+		{
+
+		}
+
+		DICTIONARY_HANDLE * m_handle;
+		READER_SLOT * m_slot;
+	};
+
+	explicit DICTIONARY_HANDLE(std::unique_ptr<DICTIONARY> initial);
+
+	// Every READER must be gone by then
+	~DICTIONARY_HANDLE();
+
+	DICTIONARY_HANDLE(const DICTIONARY_HANDLE &) = delete;
+	DICTIONARY_HANDLE & operator=(const DICTIONARY_HANDLE &) = delete;
+
+	READER reader();
+
+	// Makes replacement the current dictionary. Returns right away, readers still on the old one keep it until they
+	// drop their snapshots.
+	void publish(std::unique_ptr<DICTIONARY> replacement);
+
+	// Runs loader on the background thread and publishes what it returns, e.g.
+	//   handle.reload([] { return std::unique_ptr<DICTIONARY>(new DICTIONARY("domain.dict")); });
+	// If loader throws, the current dictionary stays and the exception is kept for last_reload_error().
+	void reload(LOADER loader);
+
+	// Exception of the last failed reload, null if it succeeded
+	std::exception_ptr last_reload_error() const;
+
+	// Number of publishes so far
+	std::uint64_t version() const
+	{
+		return m_version.load(std::memory_order_relaxed);
+	}
+
+	// Replaced dictionaries not freed yet, because a snapshot may still be using them
+	std::size_t num_retired() const;
+
+private:
+	struct RETIRED
+	{
+		std::unique_ptr<const DICTIONARY> dict;
+		std::uint64_t epoch;   // Snapshots entered in an earlier epoch may still use it
+	};
+
+	// How often the background thread checks whether retired dictionaries can go. Readers never signal it.
+	static constexpr unsigned RECLAIM_INTERVAL_MS = 10;
+
+	void background_main();
+	void reclaim();  // m_mutex held
+
+	std::atomic<const DICTIONARY *> m_current;  // Owned
+	std::atomic<std::uint64_t> m_epoch;          // Bumped by every publish, never 0
+	std::atomic<std::uint64_t> m_version;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<std::unique_ptr<READER_SLOT>> m_slots;
+	std::vector<RETIRED> m_retired;
+	std::vector<LOADER> m_loaders;
+	std::exception_ptr m_reload_error;
+	bool m_stopping;
+	std::thread m_background;
+};
+
+} // End Namespace
+
+#endif
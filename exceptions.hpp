@@ -0,0 +1,34 @@
+#ifndef SENTENCE_BREAKER_EXCEPTIONS_HPP
+#define SENTENCE_BREAKER_EXCEPTIONS_HPP
+
+#include <exception>
+
+namespace SENTENCE_BREAKER
+{
+
+namespace EXCEPTIONS
+{
+	class NON_ALPHABETICAL_EXCEPTION : public std::exception
+	{
+
+	};
+
+	class IMPOSSIBLE_MATCH_EXCEPTION : public std::exception
+	{
+
+	};
+
+	// A compiled dictionary file that is truncated, from another version of dictc or from a machine with another byte order.
+	class BAD_DICTIONARY_FILE_EXCEPTION : public std::exception
+	{
+	public:
+		const char * what() const noexcept override
+		{
+			return "not a compiled dictionary file of a supported version";
+		}
+	};
+};
+
+} // End Namespace
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef SENTENCE_BREAKER_LAYERED_DICTIONARY_HPP
+#define SENTENCE_BREAKER_LAYERED_DICTIONARY_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "dictionary.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+// The union of a few frozen dictionaries, e.g. a big shared base plus small per tenant domain and user overlays.
+//
+// Nothing is copied or merged: a layered cursor steps one cursor per layer in lock step and ORs their answers, so a
+// word is a word when any layer has it, and a prefix when any layer continues it. A layer whose cursor has fallen off
+// its trie is skipped for the rest of the word, so past the first few characters most steps only touch one trie.
+//
+// A LAYERED_DICTIONARY is a handful of pointers, cheap enough to be put together per request (from DICTIONARY_HANDLE
+// snapshots, for instance). The layers must outlive it. Every engine accepts one in place of a DICTIONARY.
+class LAYERED_DICTIONARY
+{
+public:
+	static constexpr std::size_t MAX_LAYERS = 4;
+
+	explicit LAYERED_DICTIONARY(const DICTIONARY & base)
+	:
+		m_layers(),
+		m_num_layers(1)
+	{
+		m_layers[0] = &base;
+	}
+
+	// Throws std::length_error past MAX_LAYERS
+	void add_layer(const DICTIONARY & overlay)
+	{
+		if (m_num_layers == MAX_LAYERS)
+		{
+			throw std::length_error("LAYERED_DICTIONARY: too many layers");
+		}
+		m_layers[m_num_layers++] = &overlay;
+	}
+
+	std::size_t num_layers() const
+	{
+		return m_num_layers;
+	}
+
+	// Longest word of any layer
+	std::size_t max_word_length() const
+	{
+		std::size_t length = 0;
+		for (std::size_t layer = 0; layer < m_num_layers; ++layer)
+		{
+			length = std::max(length, m_layers[layer]->max_word_length());
+		}
+		return length;
+	}
+
+	// Same answers as DICTIONARY::prefix_match would give on the union of the layers
+	std::pair<bool, bool> prefix_match(std::string::const_iterator begin_prefix, std::string::const_iterator end_prefix) const
+	{
+		std::pair<bool, bool> match(false, false);
+		for (std::size_t layer = 0; layer < m_num_layers; ++layer)
+		{
+			const std::pair<bool, bool> layer_match = m_layers[layer]->prefix_match(begin_prefix, end_prefix);
+			match.first  = match.first  || layer_match.first;
+			match.second = match.second || layer_match.second;
+		}
+		return match;
+	}
+
+	// DICTIONARY::CURSOR over the union, with the same contract
+	class CURSOR
+	{
+	public:
+		explicit CURSOR(const LAYERED_DICTIONARY & dict)
+		:
+			m_cursors{ { dict.layer_cursor(0), dict.layer_cursor(1), dict.layer_cursor(2), dict.layer_cursor(3) } },
+			m_num_layers(static_cast<unsigned>(dict.m_num_layers)),
+			m_live_layers(all_layers()),
+			m_cost(0)
+		{
+			static_assert(MAX_LAYERS == 4, "initialize one cursor per layer");
+		}
+
+		std::pair<bool, bool> advance(char c)
+		{
+			bool is_word = false, is_prefix = false;
+			m_cost = std::numeric_limits<DICTIONARY::COST>::max();
+			for (unsigned layer = 0; layer < m_num_layers; ++layer)
+			{
+				if (!(m_live_layers & (1u << layer)))
+				{
+					continue;
+				}
+				const std::pair<bool, bool> match = m_cursors[layer].advance(c);
+				if (!match.first && !match.second)
+				{
+					m_live_layers &= ~(1u << layer);
+				}
+				if (match.first)
+				{
+					m_cost = std::min(m_cost, m_cursors[layer].cost());
+				}
+				is_word   = is_word   || match.first;
+				is_prefix = is_prefix || match.second;
+			}
+			return std::make_pair(is_word, is_prefix);
+		}
+
+		// Cheapest cost among the layers that have the word, when the last advance said it is one.
+		// Costs of different layers are only comparable if their word lists were counted over similar text.
+		DICTIONARY::COST cost() const
+		{
+			return m_cost;
+		}
+
+		// Longest completion among the layers still on their tries
+		unsigned completion() const
+		{
+			unsigned completion = 0;
+			for (unsigned layer = 0; layer < m_num_layers; ++layer)
+			{
+				if (m_live_layers & (1u << layer))
+				{
+					completion = std::max(completion, m_cursors[layer].completion());
+				}
+			}
+			return completion;
+		}
+
+		void reset()
+		{
+			for (unsigned layer = 0; layer < m_num_layers; ++layer)
+			{
+				m_cursors[layer].reset();
+			}
+			m_live_layers = all_layers();
+		}
+
+	private:
+		unsigned all_layers() const
+		{
+			return (1u << m_num_layers) - 1;
+		}
+
+		std::array<DICTIONARY::CURSOR, MAX_LAYERS> m_cursors;
+		unsigned m_num_layers;
+		unsigned m_live_layers;  // Bit per layer whose cursor is still on its trie
+		DICTIONARY::COST m_cost;
+	};
+
+	CURSOR cursor() const
+	{
+		return CURSOR(*this);
+	}
+
+private:
+	// Unused cursor slots get a cursor of the base layer, they are never advanced
+	DICTIONARY::CURSOR layer_cursor(std::size_t layer) const
+	{
+		return m_layers[layer < m_num_layers ? layer : 0]->cursor();
+	}
+
+	std::array<const DICTIONARY *, MAX_LAYERS> m_layers;
+	std::size_t m_num_layers;
+};
+
+} // End Namespace
+
+#endif
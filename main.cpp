@@ -1,268 +1,333 @@
+// Usage: main [-d word list | -c compiled dictionary] [-m greedy | fewest | unigram] [--minimize | --links] [filters] [--unknown] [--cache MiB] [--stats] [input file]
+//        main [dictionary and mode options as above] [--threads n] [--stats] --listen address:port | unix:path ...
+//
+// Splits every whitespace separated token of the input file (or stdin) into dictionary words, one word per line.
+// An input file is mapped, stdin is read in large chunks. Defaults to the word list merriam-webster.dict, or in the
+// main_embedded build (make embedded) to the dictionary compiled into the program.
+// --unknown writes the runs of a token that no word covers as their own lines, instead of the whole token unchanged.
+// --minimize loads the word list as a minimized DAWG (compiled dictionaries are stored in whichever form dictc wrote).
+// --links builds the word list with match links, which the fewest and unigram modes scan in one pass per token
+// (see DICTIONARY::LOAD_OPTIONS::match_links).
+// Filters apply to a word list as dictc's do (see DICTIONARY::LOAD_OPTIONS): --min-length n, --max-length n (code
+// points), --letters-only, --alphabet chars, --min-count n. A compiled dictionary was filtered when dictc built it.
+// --cache keeps the segmentations of recent tokens in a SEGMENTATION_CACHE of that many MiB.
+// --stats writes the hot path counters to stderr at exit; they are only counted in a STATS=1 build, where SIGUSR1
+// also dumps them at the next chunk boundary. The cache counters and the dictionary report (DICTIONARY::REPORT) are
+// always written.
+// --listen serves length prefixed requests instead, on every TCP address and Unix socket given, until SIGINT or SIGTERM
+// (see SEGMENTATION_SERVER), segmenting on a pool of --threads workers (default one per hardware thread). SIGUSR1
+// dumps the server counters, SIGHUP reloads the dictionary from its file; --stats writes the counters at exit.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <iostream>
-#include <fstream>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
-#include <utility>
-#include <tuple>
-#include <exception>
-#include <cctype>
-#include <boost/container/flat_map.hpp>
+#include "dictionary.hpp"
+#include "dictionary_handle.hpp"
+#include "break_sentence.hpp"
+#include "mapped_file.hpp"
+#include "segment_stream.hpp"
+#include "segmentation_cache.hpp"
+#include "segmentation_server.hpp"
+#include "stats.hpp"
+#include "work_stealing_pool.hpp"
+#if defined(SENTENCE_BREAKER_EMBEDDED)
+#include "embedded_dictionary.hpp"
+#endif
+
+using namespace SENTENCE_BREAKER;
 
 namespace
 {
 
-namespace EXCEPTIONS
-{
-	class NON_ALPHABETICAL_EXCEPTION : public std::exception
-	{
-
-	};
+#if defined(SENTENCE_BREAKER_EMBEDDED)
+const bool HAS_EMBEDDED_DICTIONARY = true;
+#else
+const bool HAS_EMBEDDED_DICTIONARY = false;
+#endif
 
-	class IMPOSSIBLE_MATCH_EXCEPTION : public std::exception
-	{
+int usage(const char * argv0)
+{
+	std::cerr << "Usage: " << argv0 << " [-d word list | -c compiled dictionary] [-m greedy | fewest | unigram] [--minimize | --links] [--min-length n] [--max-length n] [--letters-only] [--alphabet chars] [--min-count n] [--unknown] [--cache MiB] [--stats] [input file]" << std::endl;
+	std::cerr << "       " << argv0 << " [dictionary and mode options] [--threads n] [--stats] --listen address:port | unix:path ..." << std::endl;
+	return 2;
+}
 
-	};
-};
+bool parse_count(const char * text, unsigned long & value)
+{
+	char * end = nullptr;
+	value = std::strtoul(text, &end, 10);
+	return end != text && *end == '\0';
+}
 
-// Dictionary class that quickly finds out whether a sequence of characters represents an English word, or the prefix of an English word,
-// or both
-// Implementation with a prefix tree, which allows linear time prefix feasibility test and low memory footprint
-// (Memory: O(width * height), width is no more than 26 and height is the number of characters of an average english word - 5 to 10 maybe?).
-class DICTIONARY
+// address:port, [v6 address]:port or unix:path
+void listen_on(SEGMENTATION_SERVER & server, const std::string & endpoint)
 {
-public:
-	// A dictionary file that could be useful: http://www-01.sil.org/linguistics/wordlists/english/wordlist/wordsEn.txt
-	// Just over 1 megabyte, most computers should handle.
-	DICTIONARY(const char * filename)
+	if (endpoint.compare(0, 5, "unix:") == 0)
 	{
-		load(filename);
+		server.listen_unix(endpoint.c_str() + 5);
+		return;
 	}
-
-	// Read comment for PREFIX_TREE::prefix_match
-	std::pair<bool, bool> prefix_match(std::string::const_iterator begin_prefix, std::string::const_iterator end_prefix) const
+	const std::size_t colon = endpoint.rfind(':');
+	char * end = nullptr;
+	const unsigned long port = colon != std::string::npos ? std::strtoul(endpoint.c_str() + colon + 1, &end, 10) : 0;
+	if (colon == std::string::npos || end == endpoint.c_str() + colon + 1 || *end != '\0' || port > 65535)
 	{
-		return m_prefix_tree.prefix_match(begin_prefix, end_prefix);
+		throw std::invalid_argument("bad endpoint " + endpoint);
 	}
-
-	void load(const char * filename)
+	std::string address = endpoint.substr(0, colon);
+	if (address.size() >= 2 && address.front() == '[' && address.back() == ']')
 	{
-		std::ifstream ifs(filename);
-		std::string word;
-		while (!ifs.eof())
-		{
-			word.clear();
-			ifs >> word;
-			m_prefix_tree.add_word(word);
-		}
+		address = address.substr(1, address.size() - 2);
 	}
+	server.listen_tcp(address.c_str(), static_cast<unsigned short>(port));
+}
 
-private:
-	class PREFIX_TREE
+} // End Anonymous Namespace
+
+int main(int argc, char ** argv)
+{
+	const char * word_list = nullptr;
+	const char * compiled = nullptr;
+	const char * input = nullptr;
+	SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY;
+	DICTIONARY::LOAD_OPTIONS options;
+	UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL;
+	bool print_stats = false;
+	std::size_t cache_mib = 0;
+	std::vector<std::string> endpoints;
+	unsigned num_threads = 0;
+	unsigned long value = 0;
+
+	for (int arg = 1; arg < argc; ++arg)
 	{
-		class TREE_NODE
+		if (std::strcmp(argv[arg], "-d") == 0 && arg + 1 < argc)
+		{
+			word_list = argv[++arg];
+		}
+		else if (std::strcmp(argv[arg], "-c") == 0 && arg + 1 < argc)
 		{
-		public:
-			static char sanitize_key(char c)
+			compiled = argv[++arg];
+		}
+		else if (std::strcmp(argv[arg], "-m") == 0 && arg + 1 < argc)
+		{
+			const std::string mode_name = argv[++arg];
+			if (mode_name == "greedy")
 			{
-				return std::tolower(c);
+				mode = SEGMENTATION_MODE::GREEDY;
 			}
-
-			TREE_NODE()
-			:
-				m_children(),
-				m_is_word(false)
+			else if (mode_name == "fewest")
 			{
-
+				mode = SEGMENTATION_MODE::FEWEST_WORDS;
 			}
-
-			auto add_or_find_child(char c)
+			else if (mode_name == "unigram")
 			{
-				auto emplace_result = m_children.emplace(std::make_pair(sanitize_key(c), TREE_NODE()));
-				auto emplace_iter = emplace_result.first;
-
-				return emplace_iter;
+				mode = SEGMENTATION_MODE::UNIGRAM_COST;
 			}
-
-			void set_is_word()
+			else
 			{
-				m_is_word = true;
+				return usage(argv[0]);
 			}
-
-			auto find_child(char c)
+		}
+		else if (std::strcmp(argv[arg], "--minimize") == 0)
+		{
+			options.minimize = true;
+		}
+		else if (std::strcmp(argv[arg], "--links") == 0)
+		{
+			options.match_links = true;
+		}
+		else if (std::strcmp(argv[arg], "--min-length") == 0 && arg + 1 < argc)
+		{
+			if (!parse_count(argv[++arg], value))
 			{
-				auto iter = m_children.find(sanitize_key(c));
-				return (iter == m_children.end()) ? nullptr : &(*iter);
+				return usage(argv[0]);
 			}
-
-			auto num_children() const
+			options.min_length = value;
+		}
+		else if (std::strcmp(argv[arg], "--max-length") == 0 && arg + 1 < argc)
+		{
+			if (!parse_count(argv[++arg], value))
 			{
-				return m_children.size();
+				return usage(argv[0]);
 			}
-		private:
-			boost::container::flat_map<char, TREE_NODE> m_children; // Sorted vector
-			bool m_is_word;
-		};
-
-	public:
-		// TODO: As an optimization, take positional hint to speed up ordered loading.
-		void add_word(const std::string & new_word)
+			options.max_length = value;
+		}
+		else if (std::strcmp(argv[arg], "--letters-only") == 0)
+		{
+			options.letters_only = true;
+		}
+		else if (std::strcmp(argv[arg], "--alphabet") == 0 && arg + 1 < argc)
+		{
+			options.alphabet = argv[++arg];
+		}
+		else if (std::strcmp(argv[arg], "--min-count") == 0 && arg + 1 < argc)
 		{
-			// TODO: Construct the tree branch for the word
-			TREE_NODE * last_node = &m_root;
-			for (char c : new_word)
+			if (!parse_count(argv[++arg], value) || value > ~std::uint32_t(0))
 			{
-				last_node = &((last_node->add_or_find_child(c))->second);
+				return usage(argv[0]);
 			}
-			last_node->set_is_word();
+			options.min_count = static_cast<std::uint32_t>(value);
 		}
-
-		// Match prefix to words in a dictionary represented by tree of characters (prefix as root),
-		// This implementation would be quick to determine the following two boolean return values that caller needs.
-		//
-		// Returns: bool 1: whether this substring is a word
-		//          bool 2: whether this substring is a prefix of one or more other words, excluding the substring itself
-		//
-		// A worthy optimization: Could take a hint iterator to limit the search to a subtree to speed up the search.
-		// Oftentimes we know which subtree we should look at (e.g. when we want to test whether “apple” is a word after knowing
-		//  “appl” is a prefix but not a word - we should just start from the “l” node instead of redundantly going through
-		// the a-p-p-l-e path).
-		//
-		// * Input case insensitive.
-		//
-		// Complexity: O of
-		//    length of character sequence under test *
-		//    linear or binary search of a tree edge under a tree node
-		//          (Assuming English, 26 at most, so it’s arguably constant. Should be much fewer than 26 in practice)
-		std::pair<bool, bool> prefix_match(std::string::const_iterator begin_prefix, std::string::const_iterator end_prefix) const
+		else if (std::strcmp(argv[arg], "--unknown") == 0)
 		{
-			// TODO: Find whether the character sequence has a matching word (matched to a tree branch with no child)
-			// or a matching prefix (matched to a tree branch with children) or both
-			return std::make_pair(false, false);
+			policy = UNKNOWN_POLICY::EMIT_UNKNOWN;
 		}
-	private:
-
-
-		TREE_NODE m_root;
-	};
-
-	// Data Members
-	PREFIX_TREE m_prefix_tree;
-};
-
-
-// Complexity:
-// Assume I modify prefix_match to take subtree_hint iterator to limit the search scope and get rid of redundant work
-// O of input string length * linear or binary search of an edge under a dictionary tree node (which is arguably constant for English)
-//   = effectively linear
-void break_sentence(std::vector<std::string> & word_breakdown, const std::string & in_sentence, const DICTIONARY & dict)
-{
-	// Robustness consideration (not all are implemented)
-	// 1) Spaces? Handled by main string reader already. But if still exists,
-	//    just jump over them and continue matching at next real character
-	// 2) Segments of non alphabetical? Consider as one word
-	// 3) Cases? Preserve, but assume prefix_match is case insensitive
-	// 4) What if it gets stuck?
-
-	// Clear the output buffer that stores the result
-	word_breakdown.clear();
-
-	// Iterator pairs for the whole input sentences
-	const auto begin_iter = in_sentence.cbegin();
-	const auto end_iter   = in_sentence.cend();
+		else if (std::strcmp(argv[arg], "--cache") == 0 && arg + 1 < argc)
+		{
+			unsigned long value = 0;
+			if (!parse_count(argv[++arg], value) || value == 0 || value > ~std::size_t(0) >> 20)
+			{
+				return usage(argv[0]);
+			}
+			cache_mib = value;
+		}
+		else if (std::strcmp(argv[arg], "--listen") == 0 && arg + 1 < argc)
+		{
+			endpoints.push_back(argv[++arg]);
+		}
+		else if (std::strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc)
+		{
+			char * end = nullptr;
+			num_threads = static_cast<unsigned>(std::strtoul(argv[++arg], &end, 10));
+			if (*end != '\0' || num_threads == 0)
+			{
+				return usage(argv[0]);
+			}
+		}
+		else if (std::strcmp(argv[arg], "--stats") == 0)
+		{
+			print_stats = true;
+		}
+		else if (argv[arg][0] != '-' && input == nullptr)
+		{
+			input = argv[arg];
+		}
+		else
+		{
+			return usage(argv[0]);
+		}
+	}
 
-	// Iterators that stores the progress of the current word being worked on.
-	auto round_begin = begin_iter;
-	auto round_curr = begin_iter;
+	if (!endpoints.empty() && (input != nullptr || cache_mib != 0))
+	{
+		return usage(argv[0]);
+	}
 
-	// The longest match found so far for the current word being worked on.
-	std::string last_exact_match; // Always clear it when move on to a new word
-	std::string::const_iterator last_exact_match_end_iter = end_iter; // Always set to end_iter when move on to a new word
+	if (print_stats && !STATS_ENABLED)
+	{
+		std::cerr << argv[0] << ": built without counters, rebuild with make STATS=1" << std::endl;
+	}
+	if (STATS_ENABLED && endpoints.empty())
+	{
+		install_stats_signal_handler();
+	}
 
-	// Loop to greedily find the longest match and add it to the result vector, then start at next character and repeat.
-	while (round_begin != end_iter)
+	try
 	{
-		bool is_word, is_prefix;
-		std::tie(is_word, is_prefix) = dict.prefix_match(round_begin, round_curr);
+		std::unique_ptr<DICTIONARY> dict;
+		if (compiled != nullptr)
+		{
+			dict = std::make_unique<DICTIONARY>(compiled, DICTIONARY::MAPPED());
+		}
+#if defined(SENTENCE_BREAKER_EMBEDDED)
+		else if (word_list == nullptr)
+		{
+			dict = std::make_unique<DICTIONARY>(EMBEDDED_TABLES::embedded_dictionary);
+		}
+#endif
+		else
+		{
+			dict = std::make_unique<DICTIONARY>(word_list != nullptr ? word_list : "merriam-webster.dict", options);
+		}
 
-		if (is_word)
+		if (!endpoints.empty())
 		{
-			if (!is_prefix || (round_curr == end_iter))
+			// SIGHUP reloads from wherever the dictionary came from; an embedded one has nothing to reload
+			DICTIONARY_HANDLE::LOADER loader;
+			if (compiled != nullptr)
 			{
-				// Perfect. This is the longest possible solution for the current word.
-				// There’s no chance that keep appending on the current word can give us a longer result.
-				// Action: Add the word to buffer and set up everything for a new round (new word).
-
-				word_breakdown.emplace_back(round_begin, round_curr);
-				++round_curr;
-				round_begin = round_curr;
-				last_exact_match.clear();
-				last_exact_match_end_iter = end_iter;
+				loader = [compiled] { return std::unique_ptr<DICTIONARY>(new DICTIONARY(compiled, DICTIONARY::MAPPED())); };
 			}
-			else
+			else if (word_list != nullptr || !HAS_EMBEDDED_DICTIONARY)
 			{
-				// This is a good match, but there might be more possibilities if we appending to the word under test.
-				// Action: keep trying to match more characters, but save the current word and char iterator just in case
-				// All subsequent matches fail - we’ll revert to this solution by then.
-				last_exact_match.assign(round_begin, round_curr);
-				last_exact_match_end_iter = round_curr;
-				++round_curr;
+				const char * const path = word_list != nullptr ? word_list : "merriam-webster.dict";
+				loader = [path, options] { return std::unique_ptr<DICTIONARY>(new DICTIONARY(path, options)); };
 			}
 
-		}
-		else // !is_word
-		{
-			if (is_prefix)
+			DICTIONARY_HANDLE handle(std::move(dict));
+			WORK_STEALING_POOL pool(num_threads);
+			SEGMENTATION_SERVER server(handle, pool, mode, policy, loader);
+			for (const std::string & endpoint : endpoints)
 			{
-				// Not a word, but could be part of a word.
-				// Still there’s chances to find a word if we keep appending new characters.
-				// Action: Stay in current round, but expands the prefix under test.
-				++round_curr;
+				listen_on(server, endpoint);
 			}
-			else
+			server.run();
+
+			if (print_stats)
 			{
-				// We failed by either overmatching (if last exact match was set), or by impossible input (if otherwise)
-				// Action:
-				// In case of overmatching, we just revert to the last matched word, and roll back iterators for new round.
-				// Otherwise, throw an exception to signify an impossible match.
-				if (last_exact_match.empty())
-				{
-					throw EXCEPTIONS::IMPOSSIBLE_MATCH_EXCEPTION();
-				}
-				else
+				SEGMENTATION_SERVER::write_counters(stderr, server.counters());
+				DICTIONARY::write_report(stderr, handle.reader().acquire()->report());
+				if (STATS_ENABLED)
 				{
-					// Check for mismatch between last_exact_match and last_exact_match_end_iter
-					assert(last_exact_match_end_iter != end_iter);
-
-					word_breakdown.push_back(std::move(last_exact_match));
-					last_exact_match.clear();
-					last_exact_match_end_iter = end_iter;
-					round_begin = last_exact_match_end_iter + 1;
-					round_curr  = round_begin;
+					write_stats(stderr, collect_stats());
 				}
 			}
-		} // end if-else (is_word)
-	}
-}
+			return 0;
+		}
 
-} // End Namespace
+		std::unique_ptr<SEGMENTATION_CACHE> cache;
+		if (cache_mib != 0)
+		{
+			cache = std::make_unique<SEGMENTATION_CACHE>(*dict, cache_mib << 20, mode, policy);
+		}
 
+		if (input != nullptr)
+		{
+			MAPPED_FILE mapped_input(input);
+			if (cache)
+			{
+				segment_buffer(mapped_input.data(), mapped_input.size(), stdout, *cache);
+			}
+			else
+			{
+				segment_buffer(mapped_input.data(), mapped_input.size(), stdout, *dict, mode, policy);
+			}
+		}
+		else if (cache)
+		{
+			segment_stream(stdin, stdout, *cache);
+		}
+		else
+		{
+			segment_stream(stdin, stdout, *dict, mode, policy);
+		}
 
-int main()
-{
-	std::cout << "Hello world!" << std::endl;
-	std::vector<std::string> out_words;
-	std::string in_sentence;
-	DICTIONARY dict("merriam-webster.dict");
-	// Simple string reader...
-	while (std::cin.eof()) // TODO(bxing): API call correct?
-	{
-		in_sentence.clear();
-		std::cin >> in_sentence; // Reads until space. Kinda what we want.
-		break_sentence(out_words, in_sentence, dict);
-		for (const auto & word : out_words)
+		if (print_stats && STATS_ENABLED)
+		{
+			write_stats(stderr, collect_stats());
+		}
+		if (print_stats)
 		{
-			std::cout << word << std::endl;
+			DICTIONARY::write_report(stderr, dict->report());
 		}
+		if (print_stats && cache)
+		{
+			const SEGMENTATION_CACHE::COUNTERS & counters = cache->counters();
+			std::fprintf(stderr, "cache_hits %llu\ncache_misses %llu\ncache_evictions %llu\ncache_uncacheable %llu\n",
+				static_cast<unsigned long long>(counters.hits), static_cast<unsigned long long>(counters.misses),
+				static_cast<unsigned long long>(counters.evictions), static_cast<unsigned long long>(counters.uncacheable));
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cerr << argv[0] << ": " << e.what() << std::endl;
+		return 1;
 	}
 	return 0;
 }
@@ -0,0 +1,79 @@
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <system_error>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace SENTENCE_BREAKER
+{
+
+MAPPED_FILE::MAPPED_FILE(const char * filename)
+:
+	m_data(nullptr),
+	m_size(0)
+{
+	const int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		throw std::system_error(errno, std::generic_category(), std::string("open ") + filename);
+	}
+
+	struct stat file_stat;
+	if (::fstat(fd, &file_stat) != 0)
+	{
+		const int error = errno;
+		::close(fd);
+		throw std::system_error(error, std::generic_category(), std::string("fstat ") + filename);
+	}
+
+	// mmap refuses zero length, an empty file is simply an empty mapping
+	if (file_stat.st_size > 0)
+	{
+		void * data = ::mmap(nullptr, static_cast<std::size_t>(file_stat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			const int error = errno;
+			::close(fd);
+			throw std::system_error(error, std::generic_category(), std::string("mmap ") + filename);
+		}
+		m_data = data;
+		m_size = static_cast<std::size_t>(file_stat.st_size);
+	}
+
+	// The mapping keeps its own reference to the file
+	::close(fd);
+}
+
+MAPPED_FILE & MAPPED_FILE::operator=(MAPPED_FILE && other) noexcept
+{
+	if (this != &other)
+	{
+		unmap();
+		m_data = other.m_data;
+		m_size = other.m_size;
+		other.m_data = nullptr;
+		other.m_size = 0;
+	}
+	return *this;
+}
+
+MAPPED_FILE::~MAPPED_FILE()
+{
+	unmap();
+}
+
+void MAPPED_FILE::unmap() noexcept
+{
+	if (m_data != nullptr)
+	{
+		::munmap(m_data, m_size);
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
+
+} // End Namespace
@@ -0,0 +1,60 @@
+#ifndef SENTENCE_BREAKER_MAPPED_FILE_HPP
+#define SENTENCE_BREAKER_MAPPED_FILE_HPP
+
+#include <cstddef>
+
+namespace SENTENCE_BREAKER
+{
+
+// Read-only, shared memory mapping of a whole file.
+// Pages are loaded on first touch and shared through the page cache with every other process mapping the same file.
+class MAPPED_FILE
+{
+public:
+	MAPPED_FILE() noexcept
+	:
+		m_data(nullptr),
+		m_size(0)
+	{
+
+	}
+
+	// Throws std::system_error when the file cannot be opened or mapped.
+	explicit MAPPED_FILE(const char * filename);
+
+	MAPPED_FILE(MAPPED_FILE && other) noexcept
+	:
+		m_data(other.m_data),
+		m_size(other.m_size)
+	{
+		other.m_data = nullptr;
+		other.m_size = 0;
+	}
+
+	MAPPED_FILE & operator=(MAPPED_FILE && other) noexcept;
+
+	MAPPED_FILE(const MAPPED_FILE &) = delete;
+	MAPPED_FILE & operator=(const MAPPED_FILE &) = delete;
+
+	~MAPPED_FILE();
+
+	const char * data() const
+	{
+		return static_cast<const char *>(m_data);
+	}
+
+	std::size_t size() const
+	{
+		return m_size;
+	}
+
+private:
+	void unmap() noexcept;
+
+	void * m_data;
+	std::size_t m_size;
+};
+
+} // End Namespace
+
+#endif
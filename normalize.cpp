@@ -0,0 +1,269 @@
+#include "normalize.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace SENTENCE_BREAKER
+{
+
+namespace
+{
+
+// Lower case of a two byte code point (U+0080 to U+07FF) that folds to another two byte one, otherwise cp itself
+constexpr unsigned two_byte_lower(unsigned cp)
+{
+	return
+		(cp >= 0x00C0 && cp <= 0x00DE && cp != 0x00D7)           ? cp + 0x20 :
+		(cp >= 0x0100 && cp <= 0x0137 && cp != 0x0130 && cp % 2 == 0) ? cp + 1 :
+		(cp >= 0x0139 && cp <= 0x0148 && cp % 2 == 1)          ? cp + 1 :
+		(cp >= 0x014A && cp <= 0x0177 && cp % 2 == 0)          ? cp + 1 :
+		(cp == 0x0178)                                         ? 0x00FF :
+		(cp >= 0x0179 && cp <= 0x017E && cp % 2 == 1)          ? cp + 1 :
+		(cp >= 0x01CD && cp <= 0x01DC && cp % 2 == 1)          ? cp + 1 :
+		(cp >= 0x01DE && cp <= 0x01EF && cp % 2 == 0)          ? cp + 1 :
+		(cp >= 0x01F8 && cp <= 0x021F && cp % 2 == 0)          ? cp + 1 :
+		(cp >= 0x0222 && cp <= 0x0233 && cp % 2 == 0)          ? cp + 1 :
+		(cp == 0x0386)                                         ? 0x03AC :
+		(cp >= 0x0388 && cp <= 0x038A)                         ? cp + 0x25 :
+		(cp == 0x038C)                                         ? 0x03CC :
+		(cp == 0x038E || cp == 0x038F)                         ? cp + 0x3F :
+		(cp >= 0x0391 && cp <= 0x03AB && cp != 0x03A2)         ? cp + 0x20 :
+		(cp >= 0x0400 && cp <= 0x040F)                         ? cp + 0x50 :
+		(cp >= 0x0410 && cp <= 0x042F)                         ? cp + 0x20 :
+		(cp >= 0x0460 && cp <= 0x0481 && cp % 2 == 0)          ? cp + 1 :
+		(cp >= 0x048A && cp <= 0x04BF && cp % 2 == 0)          ? cp + 1 :
+		(cp == 0x04C0)                                         ? 0x04CF :
+		(cp >= 0x04C1 && cp <= 0x04CE && cp % 2 == 1)          ? cp + 1 :
+		(cp >= 0x04D0 && cp <= 0x052F && cp % 2 == 0)          ? cp + 1 :
+		(cp >= 0x0531 && cp <= 0x0556)                         ? cp + 0x30 :
+		cp;
+}
+
+// Letters among the two byte code points: Latin, IPA, modifiers and combining marks (so an e followed by U+0301 stays
+// one run), Greek, Cyrillic, Armenian, Hebrew, Arabic, Syriac; without their punctuation, signs and digits
+constexpr bool two_byte_letter(unsigned cp)
+{
+	return
+		cp == 0x00AA || cp == 0x00B5 || cp == 0x00BA ||
+		(cp >= 0x00C0 && cp <= 0x036F && cp != 0x00D7 && cp != 0x00F7) ||
+		(cp >= 0x0370 && cp <= 0x03FF && cp != 0x0375 && cp != 0x037E && cp != 0x0384 && cp != 0x0385 &&
+			cp != 0x0387 && cp != 0x03F6) ||
+		(cp >= 0x0400 && cp <= 0x052F && cp != 0x0482) ||
+		(cp >= 0x0531 && cp <= 0x0556) || cp == 0x0559 || (cp >= 0x0560 && cp <= 0x0588) ||
+		(cp >= 0x0591 && cp <= 0x05BD) || cp == 0x05BF || cp == 0x05C1 || cp == 0x05C2 || cp == 0x05C4 ||
+		cp == 0x05C5 || cp == 0x05C7 || (cp >= 0x05D0 && cp <= 0x05EA) || (cp >= 0x05EF && cp <= 0x05F2) ||
+		(cp >= 0x0610 && cp <= 0x061A) || (cp >= 0x0620 && cp <= 0x065F) || (cp >= 0x066E && cp <= 0x06D3) ||
+		(cp >= 0x06D5 && cp <= 0x06DC) || (cp >= 0x06DF && cp <= 0x06E8) || (cp >= 0x06EA && cp <= 0x06EF) ||
+		(cp >= 0x06FA && cp <= 0x06FC) || cp == 0x06FF ||
+		(cp >= 0x0710 && cp <= 0x07F5 && !(cp >= 0x07C0 && cp <= 0x07C9));
+}
+
+// Every two byte code point's lower case in the low 11 bits, bit 15 set for letters. 3.75 KB of .rodata.
+struct TWO_BYTE_TABLE
+{
+	std::uint16_t entries[0x800 - 0x80];
+};
+
+constexpr TWO_BYTE_TABLE make_two_byte_table()
+{
+	TWO_BYTE_TABLE table = {};
+	for (unsigned cp = 0x80; cp < 0x800; ++cp)
+	{
+		table.entries[cp - 0x80] = static_cast<std::uint16_t>(two_byte_lower(cp) | (two_byte_letter(cp) ? 0x8000u : 0u));
+	}
+	return table;
+}
+
+constexpr TWO_BYTE_TABLE TWO_BYTE = make_two_byte_table();
+
+// Three byte code points: few fold, and most of the plane is letters of scripts without case, so ranges do
+constexpr unsigned three_byte_lower(unsigned cp)
+{
+	return
+		(cp >= 0x1E00 && cp <= 0x1E95 && cp % 2 == 0) ? cp + 1 :
+		(cp >= 0x1EA0 && cp <= 0x1EFF && cp % 2 == 0) ? cp + 1 :
+		(cp >= 0xFF21 && cp <= 0xFF3A)                ? cp + 0x20 :
+		cp;
+}
+
+constexpr bool three_byte_letter(unsigned cp)
+{
+	return
+		!(cp >= 0x2000 && cp <= 0x2BFF) &&  // Punctuation, sub- and superscripts, currency, arrows, math, box drawing, dingbats
+		!(cp >= 0x2E00 && cp <= 0x2E7F) &&  // Supplemental punctuation
+		!(cp >= 0x3000 && cp <= 0x303F) &&  // CJK symbols and punctuation
+		!(cp >= 0xE000 && cp <= 0xF8FF) &&  // Private use
+		!(cp >= 0xFE10 && cp <= 0xFE1F) && !(cp >= 0xFE30 && cp <= 0xFE6F) && cp != 0xFEFF &&
+		!(cp >= 0xFF00 && cp <= 0xFF20) && !(cp >= 0xFF3B && cp <= 0xFF40) && !(cp >= 0xFF5B && cp <= 0xFF65) &&
+		!(cp >= 0xFFF0);
+}
+
+constexpr bool four_byte_letter(unsigned cp)
+{
+	return !(cp >= 0x1F000 && cp <= 0x1FAFF) && !(cp >= 0xE0000);  // Emoji and symbols, tags and private use
+}
+
+// Appends a run end for every class change in a block. Bit i of alpha_mask tells whether block[i] is a letter;
+// is_alpha_run is the class of the byte before the block on entry, and of the block's last byte on exit.
+inline void add_run_ends(std::uint64_t alpha_mask, unsigned width, std::size_t block_offset, bool & is_alpha_run,
+	std::vector<std::size_t> & run_ends)
+{
+	const std::uint64_t width_mask = (std::uint64_t(1) << width) - 1;
+	std::uint64_t changes = (alpha_mask ^ ((alpha_mask << 1) | (is_alpha_run ? 1 : 0))) & width_mask;
+	while (changes != 0)
+	{
+		run_ends.push_back(block_offset + static_cast<std::size_t>(__builtin_ctzll(changes)));
+		changes &= changes - 1;
+	}
+	is_alpha_run = ((alpha_mask >> (width - 1)) & 1) != 0;
+}
+
+} // End Anonymous Namespace
+
+std::size_t fold_code_point(const char * text, std::size_t available, char * folded, bool & letter)
+{
+	const unsigned char lead = static_cast<unsigned char>(text[0]);
+	if (lead < 0x80)
+	{
+		letter = is_alpha(text[0]);
+		folded[0] = letter ? static_cast<char>(lead | 0x20) : text[0];
+		return 1;
+	}
+
+	// Decode, rejecting anything that isn't the shortest encoding of a scalar value
+	const std::size_t length = code_point_length(text[0]);
+	static const unsigned LEAD_BITS[] = { 0, 0, 0x1F, 0x0F, 0x07 };
+	static const unsigned MIN_CODE_POINT[] = { 0, 0, 0x80, 0x800, 0x10000 };
+	bool valid = length > 1 && length <= available;
+	unsigned cp = lead & LEAD_BITS[length];
+	for (std::size_t byte = 1; valid && byte < length; ++byte)
+	{
+		valid = is_continuation(text[byte]);
+		cp = (cp << 6) | (static_cast<unsigned char>(text[byte]) & 0x3F);
+	}
+	if (!valid || cp < MIN_CODE_POINT[length] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+	{
+		letter = false;
+		folded[0] = text[0];
+		return 1;
+	}
+
+	switch (length)
+	{
+	case 2:
+	{
+		const unsigned entry = TWO_BYTE.entries[cp - 0x80];
+		const unsigned lower = entry & 0x7FF;
+		letter = (entry & 0x8000) != 0;
+		folded[0] = static_cast<char>(0xC0 | (lower >> 6));
+		folded[1] = static_cast<char>(0x80 | (lower & 0x3F));
+		break;
+	}
+	case 3:
+	{
+		const unsigned lower = three_byte_lower(cp);
+		letter = three_byte_letter(cp);
+		folded[0] = static_cast<char>(0xE0 | (lower >> 12));
+		folded[1] = static_cast<char>(0x80 | ((lower >> 6) & 0x3F));
+		folded[2] = static_cast<char>(0x80 | (lower & 0x3F));
+		break;
+	}
+	default:
+		letter = four_byte_letter(cp);
+		std::memcpy(folded, text, 4);
+		break;
+	}
+	return length;
+}
+
+void fold_text(const char * text, std::size_t length, char * folded)
+{
+	for (std::size_t pos = 0; pos < length; )
+	{
+		bool letter;
+		pos += fold_code_point(text + pos, length - pos, folded + pos, letter);
+	}
+}
+
+bool fold_and_classify(const char * token, std::size_t length, char * folded, std::vector<std::size_t> & run_ends)
+{
+	run_ends.clear();
+	if (length == 0)
+	{
+		return true;
+	}
+
+	bool first_is_alpha;
+	fold_code_point(token, length, folded, first_is_alpha);
+	bool is_alpha_run = first_is_alpha;
+	std::size_t pos = 0;
+
+	// Code point by code point up to `until`, or just past it when a code point straddles it
+	auto fold_code_points = [&](std::size_t until)
+	{
+		while (pos < until)
+		{
+			bool letter;
+			const std::size_t code_point = fold_code_point(token + pos, length - pos, folded + pos, letter);
+			if (letter != is_alpha_run)
+			{
+				run_ends.push_back(pos);
+				is_alpha_run = letter;
+			}
+			pos += code_point;
+		}
+	};
+
+	// A byte is a letter iff (byte | 0x20) is in ['a', 'z']. Folding sets 0x20 on letters only. A block with a byte
+	// >= 0x80 (the sign bits) goes through fold_code_points instead.
+#if defined(__AVX2__)
+	const __m256i case_bit = _mm256_set1_epi8(0x20);
+	const __m256i before_a = _mm256_set1_epi8('a' - 1);
+	const __m256i after_z  = _mm256_set1_epi8('z' + 1);
+	while (pos + 32 <= length)
+	{
+		const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(token + pos));
+		if (_mm256_movemask_epi8(bytes) != 0)
+		{
+			fold_code_points(pos + 32);
+			continue;
+		}
+		const __m256i lower = _mm256_or_si256(bytes, case_bit);
+		const __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, before_a), _mm256_cmpgt_epi8(after_z, lower));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(folded + pos), _mm256_or_si256(bytes, _mm256_and_si256(alpha, case_bit)));
+		add_run_ends(static_cast<std::uint32_t>(_mm256_movemask_epi8(alpha)), 32, pos, is_alpha_run, run_ends);
+		pos += 32;
+	}
+#elif defined(__SSE2__)
+	const __m128i case_bit = _mm_set1_epi8(0x20);
+	const __m128i before_a = _mm_set1_epi8('a' - 1);
+	const __m128i after_z  = _mm_set1_epi8('z' + 1);
+	while (pos + 16 <= length)
+	{
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(token + pos));
+		if (_mm_movemask_epi8(bytes) != 0)
+		{
+			fold_code_points(pos + 16);
+			continue;
+		}
+		const __m128i lower = _mm_or_si128(bytes, case_bit);
+		const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, before_a), _mm_cmplt_epi8(lower, after_z));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(folded + pos), _mm_or_si128(bytes, _mm_and_si128(alpha, case_bit)));
+		add_run_ends(static_cast<std::uint32_t>(_mm_movemask_epi8(alpha)), 16, pos, is_alpha_run, run_ends);
+		pos += 16;
+	}
+#endif
+
+	fold_code_points(length);
+
+	run_ends.push_back(length);
+	return first_is_alpha;
+}
+
+} // End Namespace
@@ -0,0 +1,69 @@
+#ifndef SENTENCE_BREAKER_NORMALIZE_HPP
+#define SENTENCE_BREAKER_NORMALIZE_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace SENTENCE_BREAKER
+{
+
+// ASCII case folding of a single character. Locale independent, unlike std::tolower.
+inline char fold_ascii(char c)
+{
+	return (static_cast<unsigned>(static_cast<unsigned char>(c) - 'A') < 26u) ? static_cast<char>(c | 0x20) : c;
+}
+
+// ASCII letters, the fast path of fold_and_classify. Bytes >= 0x80 never are; whether the code point they belong to
+// is a letter is up to fold_code_point.
+inline bool is_alpha(char c)
+{
+	return static_cast<unsigned>(static_cast<unsigned char>(c | 0x20) - 'a') < 26u;
+}
+
+// UTF-8 continuation byte (10xxxxxx), which never starts a code point
+inline bool is_continuation(char c)
+{
+	return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// Bytes of the code point that `lead` starts, for valid UTF-8: what fold_and_classify puts in a run of letters always
+// is. 1 for ASCII and for bytes that start no sequence.
+inline std::size_t code_point_length(char lead)
+{
+	const unsigned char byte = static_cast<unsigned char>(lead);
+	return byte < 0xC0 ? 1 : byte < 0xE0 ? 2 : byte < 0xF0 ? 3 : byte < 0xF8 ? 4 : 1;
+}
+
+// Case folds the UTF-8 code point at `text` (at most `available` bytes, at least 1) into `folded`, and returns its
+// length in bytes; folded receives exactly that many. letter tells whether the code point is one.
+//
+// Folding and the letter classes come from constexpr tables, never from the locale: ASCII, Latin-1, Latin Extended-A
+// and -B, Latin Extended Additional, Greek, Cyrillic, Armenian and fullwidth Latin fold to lower case, as long as
+// the lower case letter has the same UTF-8 length (so not U+0130 or U+1E9E). Other scripts have no case; their
+// letters are letters, while punctuation, symbols, emoji and private use are not.
+// A byte that doesn't start a valid sequence (stray continuation, overlong form, surrogate, truncated sequence)
+// is its own one byte code point and never a letter, so a run of letters only ever holds valid UTF-8.
+std::size_t fold_code_point(const char * text, std::size_t available, char * folded, bool & letter);
+
+// fold_code_point over a whole text, same length out. How the dictionary stores its words.
+void fold_text(const char * text, std::size_t length, char * folded);
+
+// The whitespace that separates tokens and dictionary words. Locale independent, unlike std::isspace.
+inline bool is_space(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Pre-pass the engines run once per token, so that the trie only ever sees folded letters.
+//
+// Writes the case folded token to `folded` (room for `length` bytes) and splits it into maximal runs of letters and
+// of everything else, code point by code point (see fold_code_point). The runs alternate, run_ends receives the end
+// offset of each one in order, always on a code point start. Returns whether the first run is letters.
+//
+// Uses AVX2 or SSE2 when the build targets them (see ARCHFLAGS in the Makefile), otherwise a scalar loop; either way
+// only blocks with a byte >= 0x80 leave the ASCII path.
+bool fold_and_classify(const char * token, std::size_t length, char * folded, std::vector<std::size_t> & run_ends);
+
+} // End Namespace
+
+#endif
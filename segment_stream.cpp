@@ -0,0 +1,217 @@
+#include "segment_stream.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "normalize.hpp"
+#include "stats.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+namespace
+{
+
+const std::size_t CHUNK_SIZE = std::size_t(1) << 20;
+
+// Appends the output for every token of [data, data + length), which must not end in the middle of a token.
+// segment(token, length) fills words, from the dictionary or from a cache.
+template <typename SEGMENT>
+void append_tokens(const char * data, std::size_t length, std::string & out, const std::vector<WORD_SPAN> & words,
+	SEGMENT segment)
+{
+	const char * const end = data + length;
+	const char * iter = data;
+	for (;;)
+	{
+		while (iter != end && is_space(*iter))
+		{
+			++iter;
+		}
+		if (iter == end)
+		{
+			return;
+		}
+		const char * const token = iter;
+		while (iter != end && !is_space(*iter))
+		{
+			++iter;
+		}
+		const std::size_t token_length = static_cast<std::size_t>(iter - token);
+
+		const SEGMENTATION_RESULT result = segment(token, token_length);
+		if (result.status != SEGMENTATION_STATUS::OK)
+		{
+			out.append(token, token_length);
+			out.push_back('\n');
+			continue;
+		}
+		for (const WORD_SPAN & word : words)
+		{
+			out.append(token + word.offset, word.length);
+			out.push_back('\n');
+		}
+	}
+}
+
+// Segments complete tokens into a single output buffer.
+class TOKEN_WRITER
+{
+public:
+	TOKEN_WRITER(const DICTIONARY & dict, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy, std::FILE * out)
+	:
+		m_dict(dict),
+		m_mode(mode),
+		m_policy(policy),
+		m_cache(nullptr),
+		m_out(out),
+		m_words(),
+		m_out_buffer()
+	{
+		m_out_buffer.reserve(2 * CHUNK_SIZE);
+	}
+
+	TOKEN_WRITER(SEGMENTATION_CACHE & cache, std::FILE * out)
+	:
+		TOKEN_WRITER(cache.dict(), cache.mode(), cache.policy(), out)
+	{
+		m_cache = &cache;
+	}
+
+	// [data, data + length) must not end in the middle of a token
+	void write_tokens(const char * data, std::size_t length)
+	{
+		append_tokens(data, length, m_out_buffer, m_words, [this](const char * token, std::size_t token_length)
+		{
+			return m_cache != nullptr
+				? m_cache->try_break_sentence(m_words, token, token_length)
+				: try_break_sentence(m_words, token, token_length, m_dict, m_mode, m_policy);
+		});
+	}
+
+	void flush()
+	{
+		if (!m_out_buffer.empty() && std::fwrite(m_out_buffer.data(), 1, m_out_buffer.size(), m_out) != m_out_buffer.size())
+		{
+			throw std::system_error(errno, std::generic_category(), "write");
+		}
+		if (std::fflush(m_out) != 0)
+		{
+			throw std::system_error(errno, std::generic_category(), "write");
+		}
+		m_out_buffer.clear();
+
+		// Chunk boundaries are where a requested counter dump goes out, see install_stats_signal_handler
+		if (take_stats_dump_request())
+		{
+			write_stats(stderr, collect_stats());
+		}
+	}
+
+private:
+	const DICTIONARY & m_dict;
+	const SEGMENTATION_MODE m_mode;
+	const UNKNOWN_POLICY m_policy;
+	SEGMENTATION_CACHE * m_cache;
+	std::FILE * const m_out;
+	std::vector<WORD_SPAN> m_words;
+	std::string m_out_buffer;
+};
+
+void stream_tokens(std::FILE * in, TOKEN_WRITER & writer)
+{
+	std::vector<char> buffer(CHUNK_SIZE);
+	std::size_t carried = 0;  // Unfinished token from the previous chunk, at the front of the buffer
+
+	for (;;)
+	{
+		if (carried == buffer.size())
+		{
+			buffer.resize(2 * buffer.size());  // A single token longer than the buffer
+		}
+
+		const std::size_t num_read = std::fread(buffer.data() + carried, 1, buffer.size() - carried, in);
+		const std::size_t filled = carried + num_read;
+		if (num_read == 0)
+		{
+			if (std::ferror(in))
+			{
+				throw std::system_error(errno, std::generic_category(), "read");
+			}
+			writer.write_tokens(buffer.data(), filled);
+			writer.flush();
+			return;
+		}
+
+		// Everything up to the last whitespace is complete tokens, the rest waits for the next chunk
+		std::size_t complete = filled;
+		while (complete != 0 && !is_space(buffer[complete - 1]))
+		{
+			--complete;
+		}
+		writer.write_tokens(buffer.data(), complete);
+		writer.flush();
+
+		carried = filled - complete;
+		std::memmove(buffer.data(), buffer.data() + complete, carried);
+	}
+}
+
+void buffer_tokens(const char * data, std::size_t length, TOKEN_WRITER & writer)
+{
+	// Same chunking as segment_stream, only the chunk boundaries move forward to the next whitespace
+	std::size_t chunk_begin = 0;
+	while (chunk_begin != length)
+	{
+		std::size_t chunk_end = std::min(chunk_begin + CHUNK_SIZE, length);
+		while (chunk_end != length && !is_space(data[chunk_end]))
+		{
+			++chunk_end;
+		}
+		writer.write_tokens(data + chunk_begin, chunk_end - chunk_begin);
+		writer.flush();
+		chunk_begin = chunk_end;
+	}
+}
+
+} // End Anonymous Namespace
+
+void segment_stream(std::FILE * in, std::FILE * out, const DICTIONARY & dict, SEGMENTATION_MODE mode,
+	UNKNOWN_POLICY policy)
+{
+	TOKEN_WRITER writer(dict, mode, policy, out);
+	stream_tokens(in, writer);
+}
+
+void segment_buffer(const char * data, std::size_t length, std::FILE * out, const DICTIONARY & dict,
+	SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	TOKEN_WRITER writer(dict, mode, policy, out);
+	buffer_tokens(data, length, writer);
+}
+
+void segment_text(const char * data, std::size_t length, std::string & out, std::vector<WORD_SPAN> & words,
+	const DICTIONARY & dict, SEGMENTATION_MODE mode, UNKNOWN_POLICY policy)
+{
+	append_tokens(data, length, out, words, [&](const char * token, std::size_t token_length)
+	{
+		return try_break_sentence(words, token, token_length, dict, mode, policy);
+	});
+}
+
+void segment_stream(std::FILE * in, std::FILE * out, SEGMENTATION_CACHE & cache)
+{
+	TOKEN_WRITER writer(cache, out);
+	stream_tokens(in, writer);
+}
+
+void segment_buffer(const char * data, std::size_t length, std::FILE * out, SEGMENTATION_CACHE & cache)
+{
+	TOKEN_WRITER writer(cache, out);
+	buffer_tokens(data, length, writer);
+}
+
+} // End Namespace
@@ -0,0 +1,43 @@
+#ifndef SENTENCE_BREAKER_SEGMENT_STREAM_HPP
+#define SENTENCE_BREAKER_SEGMENT_STREAM_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "break_sentence.hpp"
+#include "segmentation_cache.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+// Bulk segmentation of whitespace separated text, one output word per line.
+//
+// Input is consumed in large chunks and tokens are segmented in place, output goes through one buffer that is
+// written and flushed once per chunk. A token that cannot be segmented is written unchanged, so one bad token
+// doesn't stop the stream; with UNKNOWN_POLICY::EMIT_UNKNOWN only its unknown runs are, each on its own line.
+//
+// Both throw std::system_error on read or write errors.
+
+// Reads `in` in 1 MiB chunks until end of file.
+void segment_stream(std::FILE * in, std::FILE * out, const DICTIONARY & dict,
+	SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY, UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+// Input already in memory, typically a MAPPED_FILE.
+void segment_buffer(const char * data, std::size_t length, std::FILE * out, const DICTIONARY & dict,
+	SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY, UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+// What segment_buffer writes, appended to `out` instead; words is scratch space that callers reuse between calls.
+// For callers that ship the output themselves, such as SEGMENTATION_SERVER. Never throws std::system_error.
+void segment_text(const char * data, std::size_t length, std::string & out, std::vector<WORD_SPAN> & words,
+	const DICTIONARY & dict, SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY,
+	UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+// The same, every token looked up in the cache first; dictionary, mode and policy are the cache's
+void segment_stream(std::FILE * in, std::FILE * out, SEGMENTATION_CACHE & cache);
+
+void segment_buffer(const char * data, std::size_t length, std::FILE * out, SEGMENTATION_CACHE & cache);
+
+} // End Namespace
+
+#endif
@@ -0,0 +1,174 @@
+#include "segmentation_cache.hpp"
+
+#include <cstring>
+
+namespace SENTENCE_BREAKER
+{
+
+namespace
+{
+
+const std::size_t CACHE_LINE = 64;
+
+std::uint64_t mix(std::uint64_t value)
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ull;
+	value ^= value >> 33;
+	return value;
+}
+
+// Eight bytes per multiply, the tail zero padded; the length goes into the seed so that padding can't collide
+std::uint64_t hash_token(const char * token, std::size_t length)
+{
+	std::uint64_t hash = 0x9e3779b97f4a7c15ull ^ length;
+	std::size_t pos = 0;
+	for (; pos + 8 <= length; pos += 8)
+	{
+		std::uint64_t chunk;
+		std::memcpy(&chunk, token + pos, 8);
+		hash = (hash ^ chunk) * 0x100000001b3ull;
+		hash ^= hash >> 29;
+	}
+	if (pos != length)
+	{
+		std::uint64_t chunk = 0;
+		std::memcpy(&chunk, token + pos, length - pos);
+		hash = (hash ^ chunk) * 0x100000001b3ull;
+	}
+	return mix(hash);
+}
+
+} // End Anonymous Namespace
+
+constexpr std::size_t SEGMENTATION_CACHE::ENTRY_BYTES;
+constexpr std::size_t SEGMENTATION_CACHE::WAYS;
+
+SEGMENTATION_CACHE::SEGMENTATION_CACHE(const DICTIONARY & dict, std::size_t max_bytes, SEGMENTATION_MODE mode,
+	UNKNOWN_POLICY policy)
+:
+	m_dict(dict),
+	m_mode(mode),
+	m_policy(policy),
+	m_storage(),
+	m_entries(nullptr),
+	m_num_sets(1),
+	m_clock(0),
+	m_counters()
+{
+	while (m_num_sets * WAYS * sizeof(ENTRY) <= max_bytes / 2)
+	{
+		m_num_sets *= 2;
+	}
+
+	m_storage.reset(new char[m_num_sets * WAYS * sizeof(ENTRY) + CACHE_LINE]);
+	const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(m_storage.get());
+	m_entries = reinterpret_cast<ENTRY *>(m_storage.get() + (CACHE_LINE - address % CACHE_LINE) % CACHE_LINE);
+	clear();
+}
+
+void SEGMENTATION_CACHE::clear()
+{
+	std::memset(static_cast<void *>(m_entries), 0, m_num_sets * WAYS * sizeof(ENTRY));
+}
+
+SEGMENTATION_RESULT SEGMENTATION_CACHE::try_break_sentence(std::vector<WORD_SPAN> & word_breakdown,
+	const char * in_sentence, std::size_t length)
+{
+	const std::uint64_t hash = hash_token(in_sentence, length);
+	const std::uint64_t tag = hash | 1;  // Never a free way
+	ENTRY * const set = m_entries + (hash >> 32 & (m_num_sets - 1)) * WAYS;
+	++m_clock;
+
+	if (length <= ENTRY_BYTES)
+	{
+		if (ENTRY * const entry = find(set, tag, in_sentence, length))
+		{
+			++m_counters.hits;
+			entry->last_use = m_clock;
+
+			word_breakdown.clear();
+			std::size_t word_begin = 0;
+			for (std::size_t word = 0; word < entry->num_words; ++word)
+			{
+				const std::size_t word_end = entry->data[entry->length + word];
+				word_breakdown.push_back(WORD_SPAN{ word_begin, word_end - word_begin,
+					(entry->unknown_mask >> word & 1) != 0 });
+				word_begin = word_end;
+			}
+
+			SEGMENTATION_RESULT result = { SEGMENTATION_STATUS::OK, length,
+				static_cast<std::size_t>(__builtin_popcount(entry->unknown_mask)) };
+			if (entry->failed)
+			{
+				result.status = SEGMENTATION_STATUS::IMPOSSIBLE_MATCH;
+				result.failure_offset = entry->failure_offset;
+			}
+			return result;
+		}
+	}
+
+	++m_counters.misses;
+	const SEGMENTATION_RESULT result = SENTENCE_BREAKER::try_break_sentence(word_breakdown, in_sentence, length, m_dict,
+		m_mode, m_policy);
+	if (length + word_breakdown.size() <= ENTRY_BYTES && word_breakdown.size() <= 32)
+	{
+		insert(set, tag, in_sentence, length, word_breakdown, result);
+	}
+	else
+	{
+		++m_counters.uncacheable;
+	}
+	return result;
+}
+
+SEGMENTATION_CACHE::ENTRY * SEGMENTATION_CACHE::find(ENTRY * set, std::uint64_t tag, const char * token,
+	std::size_t length) const
+{
+	for (std::size_t way = 0; way < WAYS; ++way)
+	{
+		ENTRY & entry = set[way];
+		if (entry.tag == tag && entry.length == length && std::memcmp(entry.data, token, length) == 0)
+		{
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+// Into a free way if there is one, otherwise over the least recently used
+void SEGMENTATION_CACHE::insert(ENTRY * set, std::uint64_t tag, const char * token, std::size_t length,
+	const std::vector<WORD_SPAN> & word_breakdown, const SEGMENTATION_RESULT & result)
+{
+	ENTRY * victim = set;
+	for (std::size_t way = 0; way < WAYS && victim->tag != 0; ++way)
+	{
+		if (set[way].tag == 0 || set[way].last_use < victim->last_use)
+		{
+			victim = &set[way];
+		}
+	}
+	if (victim->tag != 0)
+	{
+		++m_counters.evictions;
+	}
+
+	victim->tag            = tag;
+	victim->last_use       = m_clock;
+	victim->unknown_mask   = 0;
+	victim->length         = static_cast<std::uint8_t>(length);
+	victim->num_words      = static_cast<std::uint8_t>(word_breakdown.size());
+	victim->failed         = result.status != SEGMENTATION_STATUS::OK;
+	victim->failure_offset = static_cast<std::uint8_t>(result.status != SEGMENTATION_STATUS::OK ? result.failure_offset : length);
+	std::memcpy(victim->data, token, length);
+	for (std::size_t word = 0; word < word_breakdown.size(); ++word)
+	{
+		const WORD_SPAN & span = word_breakdown[word];
+		victim->data[length + word] = static_cast<unsigned char>(span.offset + span.length);
+		victim->unknown_mask |= (span.unknown ? std::uint32_t(1) : 0) << word;
+	}
+}
+
+} // End Namespace
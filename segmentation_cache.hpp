@@ -0,0 +1,112 @@
+#ifndef SENTENCE_BREAKER_SEGMENTATION_CACHE_HPP
+#define SENTENCE_BREAKER_SEGMENTATION_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "break_sentence.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+// Bounded cache of recent segmentations, keyed by the token itself.
+//
+// Real text is Zipfian: the same hashtags, domain names and identifiers come back over and over, and each of them is
+// segmented once here instead of on every occurrence. A hit is one hash of the token and one probe of a 4-way set,
+// every way a single cache line that holds the token bytes (so a hash collision can never return someone else's
+// words) and the packed ends of its words.
+//
+// A cache belongs to one thread, one dictionary, one mode and one policy; threads each keep their own (sharded per
+// thread), so there is nothing to synchronize. Call clear() after the dictionary behind it changes.
+//
+// Tokens too long to fit a way (ENTRY_BYTES between token and word ends) are segmented every time, which costs the
+// head of the distribution nothing: the tokens that repeat are short.
+class SEGMENTATION_CACHE
+{
+public:
+	struct COUNTERS
+	{
+		std::uint64_t hits;
+		std::uint64_t misses;
+		std::uint64_t evictions;
+		std::uint64_t uncacheable;  // Misses too long to keep, included in misses
+	};
+
+	// Bytes of token plus words a way can hold
+	static constexpr std::size_t ENTRY_BYTES = 44;
+
+	// Uses at most max_bytes for the entries, and at least one set
+	SEGMENTATION_CACHE(const DICTIONARY & dict, std::size_t max_bytes,
+		SEGMENTATION_MODE mode = SEGMENTATION_MODE::GREEDY, UNKNOWN_POLICY policy = UNKNOWN_POLICY::FAIL);
+
+	// try_break_sentence with the cache's dictionary, mode and policy, the result served from the cache when possible
+	SEGMENTATION_RESULT try_break_sentence(std::vector<WORD_SPAN> & word_breakdown, const char * in_sentence,
+		std::size_t length);
+
+	// Drops every entry, the counters stay
+	void clear();
+
+	const COUNTERS & counters() const
+	{
+		return m_counters;
+	}
+
+	std::size_t byte_size() const
+	{
+		return m_num_sets * WAYS * sizeof(ENTRY);
+	}
+
+	const DICTIONARY & dict() const
+	{
+		return m_dict;
+	}
+
+	SEGMENTATION_MODE mode() const
+	{
+		return m_mode;
+	}
+
+	UNKNOWN_POLICY policy() const
+	{
+		return m_policy;
+	}
+
+private:
+	static constexpr std::size_t WAYS = 4;
+
+	// One way, one cache line. data holds the token, then the end of every word: words are contiguous from the start
+	// of the token, up to its end or the failure offset.
+	struct ENTRY
+	{
+		std::uint64_t tag;           // Hash of the token, 0 for a free way
+		std::uint32_t last_use;
+		std::uint32_t unknown_mask;  // Bit i: word i is unknown
+		std::uint8_t  length;
+		std::uint8_t  num_words;
+		std::uint8_t  failed;
+		std::uint8_t  failure_offset;
+		unsigned char data[ENTRY_BYTES];
+	};
+	static_assert(sizeof(ENTRY) == 64, "one entry per cache line");
+
+	ENTRY * find(ENTRY * set, std::uint64_t tag, const char * token, std::size_t length) const;
+	void insert(ENTRY * set, std::uint64_t tag, const char * token, std::size_t length,
+		const std::vector<WORD_SPAN> & word_breakdown, const SEGMENTATION_RESULT & result);
+
+	const DICTIONARY & m_dict;
+	const SEGMENTATION_MODE m_mode;
+	const UNKNOWN_POLICY m_policy;
+
+	// Sets of WAYS entries, aligned to a cache line inside m_storage
+	std::unique_ptr<char[]> m_storage;
+	ENTRY * m_entries;
+	std::size_t m_num_sets;  // A power of two
+
+	std::uint32_t m_clock;  // Wraps after 2^32 lookups, which only makes an eviction choice or two less than LRU
+	COUNTERS m_counters;
+};
+
+} // End Namespace
+
+#endif
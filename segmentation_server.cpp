@@ -0,0 +1,724 @@
+#include "segmentation_server.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <deque>
+#include <exception>
+#include <string>
+#include <boost/asio.hpp>
+#include "segment_stream.hpp"
+#include "stats.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+constexpr std::size_t SEGMENTATION_SERVER::MAX_REQUEST_BYTES;
+constexpr std::size_t SEGMENTATION_SERVER::MAX_IN_FLIGHT;
+constexpr std::size_t SEGMENTATION_SERVER::MAX_CONNECTION_BYTES;
+constexpr std::size_t SEGMENTATION_SERVER::MAX_BUFFERED_BYTES;
+constexpr std::size_t SEGMENTATION_SERVER::LATENCY_BUCKETS;
+
+namespace
+{
+
+// Responses a single gathered write takes from the front of a connection's queue
+const std::size_t MAX_RESPONSES_PER_WRITE = 64;
+
+// A request body grows by at most this much per read, so its memory follows the bytes that actually came in
+const std::size_t READ_PIECE_BYTES = 64 << 10;
+
+void configure(boost::asio::ip::tcp::socket & socket)
+{
+	// Small responses go out as soon as they are ready instead of waiting on Nagle
+	boost::system::error_code ignored;
+	socket.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+}
+
+void configure(boost::asio::local::stream_protocol::socket &)
+{
+
+}
+
+} // End Anonymous Namespace
+
+// One request from arrival to its response being written. The text belongs to the network thread until the request
+// is queued, then to the dispatcher until the completion is posted back, then to the network thread again.
+struct SEGMENTATION_SERVER::REQUEST
+{
+	std::shared_ptr<CONNECTION> connection;
+	std::string text;
+	std::string response;
+	unsigned char response_header[4];
+	std::size_t length;  // Of the text, which the dispatcher frees; counted against the buffer limits until answered
+	std::chrono::steady_clock::time_point received;
+	bool failed;  // Segmentation threw, the connection is closed instead of answering
+	bool done;    // Response ready to be written
+};
+
+// A connection as the dispatcher and stop() see it, whatever the kind of socket
+class SEGMENTATION_SERVER::CONNECTION : public std::enable_shared_from_this<CONNECTION>
+{
+public:
+	virtual ~CONNECTION() = default;
+
+	virtual void start() = 0;
+
+	// The response of request is in, on the network thread
+	virtual void complete(REQUEST & request) = 0;
+
+	// Reading may go on if it was paused for MAX_BUFFERED_BYTES
+	virtual void resume() = 0;
+
+	// Drops the connection and every response it still owes
+	virtual void close() = 0;
+};
+
+// Reads requests one after the other while earlier ones are still being segmented, and writes the responses in
+// order: a ready response waits for those before it, then every ready one at the front goes out in a single
+// gathered write. Everything runs on the network thread, so nothing here is locked.
+//
+// Whether to read another request is only decided between requests: a request begun is read to its end, so a
+// connection paused for the server wide limit never holds a part of one while it waits for others to answer theirs.
+//
+// Queued requests point back at their connection and the connection at its queue; emptying the queue on close breaks
+// that cycle. A write in flight gathers its buffers from the responses at the front of the queue, so while there is
+// one close() leaves the queue to on_written, which only runs once Asio is done with those buffers.
+template <typename SOCKET>
+class SEGMENTATION_SERVER::SOCKET_CONNECTION : public SEGMENTATION_SERVER::CONNECTION
+{
+public:
+	SOCKET_CONNECTION(SEGMENTATION_SERVER & server, SOCKET && socket)
+	:
+		m_server(server),
+		m_socket(std::move(socket)),
+		m_header(),
+		m_reading(),
+		m_remaining(0),
+		m_buffered(0),
+		m_pending(),
+		m_write_buffers(),
+		m_writing(0),
+		m_read_paused(false),
+		m_read_closed(false),
+		m_closed(false)
+	{
+		configure(m_socket);
+	}
+
+	void start() override
+	{
+		read_next();
+	}
+
+	void complete(REQUEST & request) override
+	{
+		if (m_closed)
+		{
+			return;
+		}
+		if (request.failed)
+		{
+			close();
+			return;
+		}
+		request.done = true;
+		write_ready();
+	}
+
+	void resume() override
+	{
+		if (m_read_paused && !m_closed)
+		{
+			read_next();
+		}
+	}
+
+	void close() override
+	{
+		m_closed = true;
+		if (m_writing == 0)
+		{
+			m_pending.clear();
+		}
+		m_reading.reset();
+		const std::size_t buffered = m_buffered;
+		m_buffered = 0;
+		m_server.release_bytes(buffered);
+		boost::system::error_code ignored;
+		m_socket.close(ignored);
+	}
+
+private:
+	std::shared_ptr<SOCKET_CONNECTION> self()
+	{
+		return std::static_pointer_cast<SOCKET_CONNECTION>(shared_from_this());
+	}
+
+	// The next request, unless this connection or the server holds too many bytes of those not answered yet. Those
+	// of this connection resume it as they are written, the server resumes those it has starved.
+	void read_next()
+	{
+		m_read_paused = true;
+		if (m_pending.size() >= MAX_IN_FLIGHT || m_buffered >= MAX_CONNECTION_BYTES)
+		{
+			return;
+		}
+		if (m_server.m_buffered_bytes >= MAX_BUFFERED_BYTES)
+		{
+			m_server.m_starved.push_back(shared_from_this());
+			return;
+		}
+		m_read_paused = false;
+		read_header();
+	}
+
+	void read_header()
+	{
+		std::shared_ptr<SOCKET_CONNECTION> connection = self();
+		boost::asio::async_read(m_socket, boost::asio::buffer(m_header),
+			[connection](const boost::system::error_code & error, std::size_t)
+			{
+				connection->on_header(error);
+			});
+	}
+
+	void on_header(const boost::system::error_code & error)
+	{
+		if (error || m_closed)
+		{
+			end_of_requests();
+			return;
+		}
+
+		const std::size_t length = std::size_t(m_header[0]) | std::size_t(m_header[1]) << 8
+			| std::size_t(m_header[2]) << 16 | std::size_t(m_header[3]) << 24;
+		if (length > MAX_REQUEST_BYTES)
+		{
+			m_server.m_protocol_errors.fetch_add(1, std::memory_order_relaxed);
+			close();
+			return;
+		}
+
+		m_reading = std::make_shared<REQUEST>();
+		m_reading->connection = shared_from_this();
+		m_reading->length = length;
+		m_reading->failed = false;
+		m_reading->done = false;
+		m_remaining = length;
+		read_body();
+	}
+
+	void read_body()
+	{
+		if (m_remaining == 0)
+		{
+			on_request();
+			return;
+		}
+
+		const std::size_t offset = m_reading->text.size();
+		const std::size_t piece = m_remaining < READ_PIECE_BYTES ? m_remaining : READ_PIECE_BYTES;
+		m_reading->text.resize(offset + piece);
+		m_remaining -= piece;
+		m_buffered += piece;
+		m_server.m_buffered_bytes += piece;
+
+		std::shared_ptr<SOCKET_CONNECTION> connection = self();
+		boost::asio::async_read(m_socket, boost::asio::buffer(&m_reading->text[offset], piece),
+			[connection](const boost::system::error_code & error, std::size_t)
+			{
+				connection->on_body(error);
+			});
+	}
+
+	void on_body(const boost::system::error_code & error)
+	{
+		if (error || m_closed)
+		{
+			end_of_requests();
+			return;
+		}
+		read_body();
+	}
+
+	void on_request()
+	{
+		m_server.m_request_bytes.fetch_add(m_reading->length, std::memory_order_relaxed);
+		m_reading->received = std::chrono::steady_clock::now();
+		m_pending.push_back(m_reading);
+		m_server.enqueue(std::move(m_reading));
+		read_next();
+	}
+
+	// The client closed its side, or reading failed: answer what was read, then close
+	void end_of_requests()
+	{
+		m_reading.reset();
+		m_read_closed = true;
+		close_when_done();
+	}
+
+	void close_when_done()
+	{
+		if (m_read_closed && m_pending.empty() && m_writing == 0 && !m_closed)
+		{
+			boost::system::error_code ignored;
+			m_socket.shutdown(SOCKET::shutdown_both, ignored);
+			close();
+		}
+	}
+
+	void write_ready()
+	{
+		if (m_writing != 0 || m_closed)
+		{
+			return;
+		}
+
+		m_write_buffers.clear();
+		for (const std::shared_ptr<REQUEST> & request : m_pending)
+		{
+			if (!request->done || m_writing == MAX_RESPONSES_PER_WRITE)
+			{
+				break;
+			}
+			const std::size_t length = request->response.size();
+			for (std::size_t byte = 0; byte < 4; ++byte)
+			{
+				request->response_header[byte] = static_cast<unsigned char>(length >> 8 * byte);
+			}
+			m_write_buffers.push_back(boost::asio::buffer(request->response_header));
+			m_write_buffers.push_back(boost::asio::buffer(request->response));
+			++m_writing;
+		}
+		if (m_writing == 0)
+		{
+			close_when_done();
+			return;
+		}
+
+		std::shared_ptr<SOCKET_CONNECTION> connection = self();
+		boost::asio::async_write(m_socket, m_write_buffers,
+			[connection](const boost::system::error_code & error, std::size_t)
+			{
+				connection->on_written(error);
+			});
+	}
+
+	void on_written(const boost::system::error_code & error)
+	{
+		const std::size_t written = m_writing;
+		m_writing = 0;
+		if (m_closed)
+		{
+			// close() kept the responses this write was gathering from
+			m_pending.clear();
+			return;
+		}
+		if (error)
+		{
+			close();
+			return;
+		}
+
+		std::size_t answered = 0;
+		for (std::size_t response = 0; response < written; ++response)
+		{
+			m_server.count_response(*m_pending.front());
+			answered += m_pending.front()->length;
+			m_pending.pop_front();
+		}
+		m_buffered -= answered;
+		m_server.release_bytes(answered);
+		if (m_read_paused)
+		{
+			read_next();
+		}
+		write_ready();
+	}
+
+	SEGMENTATION_SERVER & m_server;
+	SOCKET m_socket;
+	unsigned char m_header[4];
+	std::shared_ptr<REQUEST> m_reading;             // Request whose body is being read
+	std::size_t m_remaining;                         // Of its body, not asked for yet
+	std::size_t m_buffered;                          // Request bytes read and not answered yet
+	std::deque<std::shared_ptr<REQUEST>> m_pending;  // Read and not yet answered, in request order
+	std::vector<boost::asio::const_buffer> m_write_buffers;
+	std::size_t m_writing;                           // Requests at the front of m_pending the write in flight covers
+	bool m_read_paused;                              // A limit of read_next reached
+	bool m_read_closed;
+	bool m_closed;
+};
+
+struct SEGMENTATION_SERVER::NETWORK
+{
+	explicit NETWORK(SEGMENTATION_SERVER & server)
+	:
+		server(server),
+		io(1),
+		signals(io, SIGINT, SIGTERM),
+		tcp_acceptors(),
+		unix_acceptors(),
+		unix_paths(),
+		connections()
+	{
+		signals.add(SIGUSR1);
+		signals.add(SIGHUP);
+	}
+
+	~NETWORK()
+	{
+		for (const std::string & path : unix_paths)
+		{
+			::unlink(path.c_str());
+		}
+	}
+
+	template <typename ACCEPTOR>
+	void accept(ACCEPTOR & acceptor)
+	{
+		acceptor.async_accept(
+			[this, &acceptor](const boost::system::error_code & error, typename ACCEPTOR::protocol_type::socket socket)
+			{
+				if (!acceptor.is_open())
+				{
+					return;
+				}
+				if (!error)
+				{
+					server.m_connections.fetch_add(1, std::memory_order_relaxed);
+					const std::shared_ptr<CONNECTION> connection =
+						std::make_shared<SOCKET_CONNECTION<typename ACCEPTOR::protocol_type::socket>>(server, std::move(socket));
+					track(connection);
+					connection->start();
+				}
+				accept(acceptor);
+			});
+	}
+
+	// Kept so that shutdown() can close them, pruned of the closed ones as new ones come in
+	void track(const std::shared_ptr<CONNECTION> & connection)
+	{
+		std::size_t kept = 0;
+		for (std::weak_ptr<CONNECTION> & tracked : connections)
+		{
+			if (!tracked.expired())
+			{
+				connections[kept++] = std::move(tracked);
+			}
+		}
+		connections.resize(kept);
+		connections.push_back(connection);
+	}
+
+	void wait_for_signal()
+	{
+		signals.async_wait([this](const boost::system::error_code & error, int signal)
+		{
+			if (error)
+			{
+				return;
+			}
+			if (signal == SIGUSR1)
+			{
+				server.dump_counters();
+			}
+			else if (signal == SIGHUP)
+			{
+				if (server.m_loader)
+				{
+					server.m_dicts.reload(server.m_loader);
+				}
+			}
+			else
+			{
+				shutdown();
+				return;
+			}
+			wait_for_signal();
+		});
+	}
+
+	// Once nothing is left to wait on, run() returns
+	void shutdown()
+	{
+		boost::system::error_code ignored;
+		signals.cancel(ignored);
+		for (auto & acceptor : tcp_acceptors)
+		{
+			acceptor->close(ignored);
+		}
+		for (auto & acceptor : unix_acceptors)
+		{
+			acceptor->close(ignored);
+		}
+		for (std::weak_ptr<CONNECTION> & tracked : connections)
+		{
+			if (const std::shared_ptr<CONNECTION> connection = tracked.lock())
+			{
+				connection->close();
+			}
+		}
+		connections.clear();
+	}
+
+	SEGMENTATION_SERVER & server;
+	boost::asio::io_context io;
+	boost::asio::signal_set signals;
+	std::vector<std::unique_ptr<boost::asio::ip::tcp::acceptor>> tcp_acceptors;
+	std::vector<std::unique_ptr<boost::asio::local::stream_protocol::acceptor>> unix_acceptors;
+	std::vector<std::string> unix_paths;  // Removed again when the server goes
+	std::vector<std::weak_ptr<CONNECTION>> connections;
+};
+
+SEGMENTATION_SERVER::SEGMENTATION_SERVER(DICTIONARY_HANDLE & dicts, WORK_STEALING_POOL & pool, SEGMENTATION_MODE mode,
+	UNKNOWN_POLICY policy, DICTIONARY_HANDLE::LOADER loader)
+:
+	m_dicts(dicts),
+	m_pool(pool),
+	m_mode(mode),
+	m_policy(policy),
+	m_loader(std::move(loader)),
+	m_start(std::chrono::steady_clock::now()),
+	m_network(),
+	m_buffered_bytes(0),
+	m_starved(),
+	m_mutex(),
+	m_condition(),
+	m_queue(),
+	m_stopping(false),
+	m_dispatcher(),
+	m_connections(0),
+	m_requests(0),
+	m_request_bytes(0),
+	m_response_bytes(0),
+	m_batches(0),
+	m_protocol_errors(0),
+	m_latency_us_total(0)
+{
+	for (std::atomic<std::uint64_t> & bucket : m_latency_us)
+	{
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	m_network.reset(new NETWORK(*this));
+}
+
+// The network goes first: destroying it drops the handlers still queued, and with them the last requests
+SEGMENTATION_SERVER::~SEGMENTATION_SERVER()
+{
+	m_network.reset();
+}
+
+void SEGMENTATION_SERVER::listen_tcp(const char * address, unsigned short port)
+{
+	const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::make_address(address), port);
+	std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor(new boost::asio::ip::tcp::acceptor(m_network->io));
+	acceptor->open(endpoint.protocol());
+	acceptor->set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+	acceptor->bind(endpoint);
+	acceptor->listen();
+	m_network->tcp_acceptors.push_back(std::move(acceptor));
+}
+
+void SEGMENTATION_SERVER::listen_unix(const char * path)
+{
+	// Only a socket is taken to be stale: whatever else is at path is somebody's file, not ours to delete
+	struct stat status;
+	if (::lstat(path, &status) == 0)
+	{
+		if (!S_ISSOCK(status.st_mode))
+		{
+			throw boost::system::system_error(EADDRINUSE, boost::system::system_category(),
+				std::string("listen_unix: not a socket, left alone: ") + path);
+		}
+		::unlink(path);
+	}
+	std::unique_ptr<boost::asio::local::stream_protocol::acceptor> acceptor(
+		new boost::asio::local::stream_protocol::acceptor(m_network->io, boost::asio::local::stream_protocol::endpoint(path)));
+	m_network->unix_acceptors.push_back(std::move(acceptor));
+	m_network->unix_paths.push_back(path);
+}
+
+void SEGMENTATION_SERVER::run()
+{
+	m_dispatcher = std::thread(&SEGMENTATION_SERVER::dispatcher_main, this);
+
+	for (auto & acceptor : m_network->tcp_acceptors)
+	{
+		m_network->accept(*acceptor);
+	}
+	for (auto & acceptor : m_network->unix_acceptors)
+	{
+		m_network->accept(*acceptor);
+	}
+	m_network->wait_for_signal();
+	m_network->io.run();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+	m_dispatcher.join();
+}
+
+void SEGMENTATION_SERVER::stop()
+{
+	NETWORK * const network = m_network.get();
+	boost::asio::post(network->io, [network] { network->shutdown(); });
+}
+
+void SEGMENTATION_SERVER::enqueue(std::shared_ptr<REQUEST> request)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(std::move(request));
+	}
+	m_condition.notify_one();
+}
+
+// Runs the whole backlog as one batch, so the batch grows with the load: while the pool works through one, the next
+// one queues up. The workers' readers are made here because each must stay on its worker's thread.
+void SEGMENTATION_SERVER::dispatcher_main()
+{
+	std::vector<DICTIONARY_HANDLE::READER> readers;
+	readers.reserve(m_pool.num_workers());
+	for (unsigned worker = 0; worker < m_pool.num_workers(); ++worker)
+	{
+		readers.push_back(m_dicts.reader());
+	}
+	std::vector<std::vector<WORD_SPAN>> words(m_pool.num_workers());
+
+	std::vector<std::shared_ptr<REQUEST>> batch;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+			if (m_stopping)
+			{
+				return;
+			}
+			batch.swap(m_queue);
+		}
+
+		try
+		{
+			m_pool.run(batch.size(), [&](std::size_t index, unsigned worker)
+			{
+				REQUEST & request = *batch[index];
+				const DICTIONARY_HANDLE::SNAPSHOT dict = readers[worker].acquire();
+				segment_text(request.text.data(), request.text.size(), request.response, words[worker], *dict,
+					m_mode, m_policy);
+				std::string().swap(request.text);
+			});
+		}
+		catch (const std::exception & e)
+		{
+			std::fprintf(stderr, "segmentation server: %s\n", e.what());
+			for (const std::shared_ptr<REQUEST> & request : batch)
+			{
+				request->failed = true;
+			}
+		}
+		m_batches.fetch_add(1, std::memory_order_relaxed);
+
+		std::shared_ptr<std::vector<std::shared_ptr<REQUEST>>> done(new std::vector<std::shared_ptr<REQUEST>>());
+		done->swap(batch);
+		boost::asio::post(m_network->io, [done]
+		{
+			for (const std::shared_ptr<REQUEST> & request : *done)
+			{
+				request->connection->complete(*request);
+			}
+		});
+	}
+}
+
+void SEGMENTATION_SERVER::count_response(const REQUEST & request)
+{
+	const std::uint64_t latency_us = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - request.received).count());
+	const std::size_t bucket = latency_us == 0 ? 0 : static_cast<std::size_t>(64 - __builtin_clzll(latency_us));
+
+	m_requests.fetch_add(1, std::memory_order_relaxed);
+	m_response_bytes.fetch_add(request.response.size(), std::memory_order_relaxed);
+	m_latency_us_total.fetch_add(latency_us, std::memory_order_relaxed);
+	m_latency_us[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Once under the limit again, every starved connection reads on, each starving itself again if the limit is reached
+// before its turn
+void SEGMENTATION_SERVER::release_bytes(std::size_t bytes)
+{
+	m_buffered_bytes -= bytes;
+	if (m_buffered_bytes >= MAX_BUFFERED_BYTES || m_starved.empty())
+	{
+		return;
+	}
+
+	std::vector<std::weak_ptr<CONNECTION>> starved;
+	starved.swap(m_starved);
+	for (std::weak_ptr<CONNECTION> & waiting : starved)
+	{
+		if (const std::shared_ptr<CONNECTION> connection = waiting.lock())
+		{
+			connection->resume();
+		}
+	}
+}
+
+SEGMENTATION_SERVER::COUNTERS SEGMENTATION_SERVER::counters() const
+{
+	COUNTERS counters;
+	counters.connections      = m_connections.load(std::memory_order_relaxed);
+	counters.requests         = m_requests.load(std::memory_order_relaxed);
+	counters.request_bytes    = m_request_bytes.load(std::memory_order_relaxed);
+	counters.response_bytes   = m_response_bytes.load(std::memory_order_relaxed);
+	counters.batches          = m_batches.load(std::memory_order_relaxed);
+	counters.protocol_errors  = m_protocol_errors.load(std::memory_order_relaxed);
+	counters.latency_us_total = m_latency_us_total.load(std::memory_order_relaxed);
+	for (std::size_t bucket = 0; bucket < LATENCY_BUCKETS; ++bucket)
+	{
+		counters.latency_us[bucket] = m_latency_us[bucket].load(std::memory_order_relaxed);
+	}
+	counters.uptime_ms = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - m_start).count());
+	return counters;
+}
+
+void SEGMENTATION_SERVER::write_counters(std::FILE * out, const COUNTERS & counters)
+{
+	std::fprintf(out, "server_connections %llu\n",      static_cast<unsigned long long>(counters.connections));
+	std::fprintf(out, "server_requests %llu\n",         static_cast<unsigned long long>(counters.requests));
+	std::fprintf(out, "server_request_bytes %llu\n",    static_cast<unsigned long long>(counters.request_bytes));
+	std::fprintf(out, "server_response_bytes %llu\n",   static_cast<unsigned long long>(counters.response_bytes));
+	std::fprintf(out, "server_batches %llu\n",          static_cast<unsigned long long>(counters.batches));
+	std::fprintf(out, "server_protocol_errors %llu\n",  static_cast<unsigned long long>(counters.protocol_errors));
+	std::fprintf(out, "server_latency_us_total %llu\n", static_cast<unsigned long long>(counters.latency_us_total));
+	for (std::size_t bucket = 0; bucket < LATENCY_BUCKETS; ++bucket)
+	{
+		if (counters.latency_us[bucket] != 0)
+		{
+			std::fprintf(out, "server_latency_us[%s%llu] %llu\n", bucket + 1 == LATENCY_BUCKETS ? ">=" : "<",
+				1ull << (bucket + 1 == LATENCY_BUCKETS ? bucket - 1 : bucket),
+				static_cast<unsigned long long>(counters.latency_us[bucket]));
+		}
+	}
+	std::fprintf(out, "server_uptime_ms %llu\n", static_cast<unsigned long long>(counters.uptime_ms));
+	std::fflush(out);
+}
+
+void SEGMENTATION_SERVER::dump_counters() const
+{
+	write_counters(stderr, counters());
+	if (STATS_ENABLED)
+	{
+		write_stats(stderr, collect_stats());
+	}
+}
+
+} // End Namespace
@@ -0,0 +1,138 @@
+#ifndef SENTENCE_BREAKER_SEGMENTATION_SERVER_HPP
+#define SENTENCE_BREAKER_SEGMENTATION_SERVER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "break_sentence.hpp"
+#include "dictionary_handle.hpp"
+#include "work_stealing_pool.hpp"
+
+namespace SENTENCE_BREAKER
+{
+
+// Segmentation over TCP or a Unix socket, with the dictionary resident for as long as the server runs.
+//
+// Protocol, the same in both directions: every message is a 4 byte little endian length followed by that many bytes.
+// A request is whitespace separated text. Its response is exactly what segment_buffer would write for that text, one
+// word per line. A client may send any number of requests without waiting for the responses, which come back in
+// request order on each connection. A request over MAX_REQUEST_BYTES closes the connection. Request bodies are taken
+// in pieces as they arrive, so a length prefix alone reserves nothing.
+//
+// One thread does all the socket I/O (Boost.Asio, the calling thread of run()). Complete requests go to a dispatcher
+// thread, which takes whatever has queued up across all connections as one batch and runs it on the pool, one task
+// per request. Each worker keeps its own DICTIONARY_HANDLE::READER, so a reload publishes between batches without
+// stopping anything; a batch is only ever as big as the backlog, so a lone request is not held back waiting for
+// company.
+//
+// SIGINT and SIGTERM stop the server, SIGUSR1 writes the counters (and the hot path counters of a STATS=1 build) to
+// stderr, and SIGHUP reloads the dictionary when a loader was given.
+class SEGMENTATION_SERVER
+{
+public:
+	static constexpr std::size_t MAX_REQUEST_BYTES = std::size_t(1) << 20;
+
+	// A connection stops reading new requests once this many of its requests are waiting for their responses, or
+	// once the requests it has read and not answered yet come to MAX_CONNECTION_BYTES. Every connection stops while
+	// those of all connections come to MAX_BUFFERED_BYTES. Reading goes on as responses are written.
+	static constexpr std::size_t MAX_IN_FLIGHT = 1024;
+	static constexpr std::size_t MAX_CONNECTION_BYTES = std::size_t(4) << 20;
+	static constexpr std::size_t MAX_BUFFERED_BYTES = std::size_t(256) << 20;
+
+	// Latency from the last byte of a request read to the last byte of its response written, bucket b counting the
+	// requests that took less than 2^b microseconds; the last bucket takes the rest.
+	static constexpr std::size_t LATENCY_BUCKETS = 24;
+
+	// Throughput and latency, counted whatever the build. Read them with counters() while the server runs.
+	struct COUNTERS
+	{
+		std::uint64_t connections;       // Accepted so far
+		std::uint64_t requests;          // Responses written
+		std::uint64_t request_bytes;     // Payload bytes read, length prefixes not included
+		std::uint64_t response_bytes;    // Payload bytes written
+		std::uint64_t batches;           // Pool runs of the dispatcher; requests / batches is the mean batch size
+		std::uint64_t protocol_errors;   // Connections closed over an oversized request
+		std::uint64_t latency_us_total;  // Sum of the latencies, latency_us_total / requests is the mean
+		std::uint64_t latency_us[LATENCY_BUCKETS];
+		std::uint64_t uptime_ms;         // Since construction, for rates
+	};
+
+	// The pool and the handle must outlive the server. loader, if not null, is what SIGHUP reloads.
+	SEGMENTATION_SERVER(DICTIONARY_HANDLE & dicts, WORK_STEALING_POOL & pool, SEGMENTATION_MODE mode,
+		UNKNOWN_POLICY policy, DICTIONARY_HANDLE::LOADER loader = DICTIONARY_HANDLE::LOADER());
+	~SEGMENTATION_SERVER();
+
+	SEGMENTATION_SERVER(const SEGMENTATION_SERVER &) = delete;
+	SEGMENTATION_SERVER & operator=(const SEGMENTATION_SERVER &) = delete;
+
+	// Both bind right away and throw boost::system::system_error if they can't. Call either any number of times
+	// before run(). A stale socket file at path is removed first; anything else there makes listen_unix throw with
+	// EADDRINUSE and is left as it is.
+	void listen_tcp(const char * address, unsigned short port);
+	void listen_unix(const char * path);
+
+	// Serves until stop() or a stop signal, on the calling thread
+	void run();
+
+	// From any thread. Stops accepting and closes every connection, responses not written yet are dropped.
+	void stop();
+
+	COUNTERS counters() const;
+
+	// One "server_<name> value" line per counter and per non empty latency bucket
+	static void write_counters(std::FILE * out, const COUNTERS & counters);
+
+private:
+	// Boost.Asio state and the connection types stay in segmentation_server.cpp
+	struct NETWORK;
+	class CONNECTION;
+	template <typename SOCKET> class SOCKET_CONNECTION;
+	struct REQUEST;
+
+	void dispatcher_main();
+	void enqueue(std::shared_ptr<REQUEST> request);   // Network thread
+	void count_response(const REQUEST & request);      // Network thread
+	void release_bytes(std::size_t bytes);              // Network thread
+	void dump_counters() const;
+
+	DICTIONARY_HANDLE & m_dicts;
+	WORK_STEALING_POOL & m_pool;
+	const SEGMENTATION_MODE m_mode;
+	const UNKNOWN_POLICY m_policy;
+	const DICTIONARY_HANDLE::LOADER m_loader;
+	const std::chrono::steady_clock::time_point m_start;
+
+	std::unique_ptr<NETWORK> m_network;
+
+	// Request bytes read and not answered yet over all connections, and the connections waiting for them to drop
+	// under MAX_BUFFERED_BYTES. Network thread only.
+	std::size_t m_buffered_bytes;
+	std::vector<std::weak_ptr<CONNECTION>> m_starved;
+
+	// Requests read and not yet segmented, handed from the network thread to the dispatcher
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<std::shared_ptr<REQUEST>> m_queue;
+	bool m_stopping;
+	std::thread m_dispatcher;
+
+	std::atomic<std::uint64_t> m_connections;
+	std::atomic<std::uint64_t> m_requests;
+	std::atomic<std::uint64_t> m_request_bytes;
+	std::atomic<std::uint64_t> m_response_bytes;
+	std::atomic<std::uint64_t> m_batches;
+	std::atomic<std::uint64_t> m_protocol_errors;
+	std::atomic<std::uint64_t> m_latency_us_total;
+	std::atomic<std::uint64_t> m_latency_us[LATENCY_BUCKETS];
+};
+
+} // End Namespace
+
+#endif
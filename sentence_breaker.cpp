@@ -0,0 +1,168 @@
+// The C interface of sentence_breaker.h. Every entry point catches whatever the C++ side throws and turns it into a
+// status code plus a message for sb_last_error, since an exception must never unwind into a C caller.
+
+#include "sentence_breaker.h"
+
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include "break_sentence.hpp"
+#include "dictionary.hpp"
+
+using namespace SENTENCE_BREAKER;
+
+struct sb_dictionary
+{
+	template <typename... ARGS>
+	explicit sb_dictionary(ARGS &&... args)
+	:
+		dict(std::forward<ARGS>(args)...)
+	{
+	}
+
+	DICTIONARY dict;
+};
+
+namespace
+{
+
+static_assert(SB_MODE_GREEDY == static_cast<int>(SEGMENTATION_MODE::GREEDY)
+	&& SB_MODE_FEWEST_WORDS == static_cast<int>(SEGMENTATION_MODE::FEWEST_WORDS)
+	&& SB_MODE_UNIGRAM_COST == static_cast<int>(SEGMENTATION_MODE::UNIGRAM_COST), "SB_MODE_* out of step");
+static_assert(SB_UNKNOWN_FAIL == static_cast<int>(UNKNOWN_POLICY::FAIL)
+	&& SB_UNKNOWN_EMIT == static_cast<int>(UNKNOWN_POLICY::EMIT_UNKNOWN), "SB_UNKNOWN_* out of step");
+
+// Per thread, so that neither needs a lock and the spans stop allocating once they have grown to the longest input
+thread_local std::string last_error;
+thread_local std::vector<WORD_SPAN> word_breakdown;
+
+int fail(int status, const char * message)
+{
+	try
+	{
+		last_error = message;
+	}
+	catch (...)
+	{
+		// Keeps the previous message, the status code still tells what happened
+	}
+	return status;
+}
+
+template <typename... ARGS>
+sb_dictionary * open_dictionary(ARGS &&... args)
+{
+	try
+	{
+		return new sb_dictionary(std::forward<ARGS>(args)...);
+	}
+	catch (const std::exception & e)
+	{
+		fail(SB_ERROR, e.what());
+	}
+	catch (...)
+	{
+		fail(SB_ERROR, "unknown error");
+	}
+	return nullptr;
+}
+
+} // End Anonymous Namespace
+
+unsigned sb_api_version(void)
+{
+	return SB_API_VERSION;
+}
+
+sb_dictionary * sb_dictionary_open(const char * word_list, unsigned flags)
+{
+	if (word_list == nullptr || (flags & ~(SB_OPEN_MINIMIZE | SB_OPEN_MATCH_LINKS)) != 0)
+	{
+		fail(SB_INVALID_ARGUMENT, "null path or unknown flags");
+		return nullptr;
+	}
+	DICTIONARY::LOAD_OPTIONS options;
+	options.minimize = (flags & SB_OPEN_MINIMIZE) != 0;
+	options.match_links = (flags & SB_OPEN_MATCH_LINKS) != 0;
+	return open_dictionary(word_list, options);
+}
+
+sb_dictionary * sb_dictionary_open_compiled(const char * compiled_path)
+{
+	if (compiled_path == nullptr)
+	{
+		fail(SB_INVALID_ARGUMENT, "null path");
+		return nullptr;
+	}
+	return open_dictionary(compiled_path, DICTIONARY::MAPPED());
+}
+
+void sb_dictionary_close(sb_dictionary * dict)
+{
+	delete dict;
+}
+
+int sb_segment(const sb_dictionary * dict, const char * text, size_t length, int mode, int policy,
+	uint32_t * word_ends, uint8_t * unknown, size_t capacity, sb_segmentation * result)
+{
+	if (dict == nullptr || result == nullptr || (text == nullptr && length != 0) || (word_ends == nullptr && capacity != 0))
+	{
+		return fail(SB_INVALID_ARGUMENT, "null pointer");
+	}
+	if (mode < SB_MODE_GREEDY || mode > SB_MODE_UNIGRAM_COST || (policy != SB_UNKNOWN_FAIL && policy != SB_UNKNOWN_EMIT))
+	{
+		return fail(SB_INVALID_ARGUMENT, "unknown mode or policy");
+	}
+	if (length > std::numeric_limits<std::uint32_t>::max())
+	{
+		return fail(SB_INVALID_ARGUMENT, "input too long for 32 bit offsets");
+	}
+
+	try
+	{
+		const SEGMENTATION_RESULT segmentation = try_break_sentence(word_breakdown, text, length, dict->dict,
+			static_cast<SEGMENTATION_MODE>(mode), static_cast<UNKNOWN_POLICY>(policy));
+		result->num_words = word_breakdown.size();
+		result->failure_offset = segmentation.failure_offset;
+		result->num_unknown = segmentation.num_unknown;
+		if (word_breakdown.size() > capacity)
+		{
+			return fail(SB_BUFFER_TOO_SMALL, "more words than capacity");
+		}
+
+		for (std::size_t word = 0; word < word_breakdown.size(); ++word)
+		{
+			const WORD_SPAN & span = word_breakdown[word];
+			word_ends[word] = static_cast<std::uint32_t>(span.offset + span.length);
+		}
+		if (unknown != nullptr)
+		{
+			for (std::size_t word = 0; word < word_breakdown.size(); ++word)
+			{
+				unknown[word] = word_breakdown[word].unknown ? 1 : 0;
+			}
+		}
+		return segmentation.status == SEGMENTATION_STATUS::OK ? SB_OK : SB_IMPOSSIBLE_MATCH;
+	}
+	catch (const std::bad_alloc &)
+	{
+		return fail(SB_ERROR, "out of memory");
+	}
+	catch (const std::exception & e)
+	{
+		return fail(SB_ERROR, e.what());
+	}
+	catch (...)
+	{
+		return fail(SB_ERROR, "unknown error");
+	}
+}
+
+const char * sb_last_error(void)
+{
+	return last_error.c_str();
+}
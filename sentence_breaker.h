@@ -0,0 +1,90 @@
+/*
+ * C interface of libsentence_breaker.so (make lib), for callers that can't link C++: Python's ctypes or cffi, cgo.
+ *
+ * Nothing that needs marshaling crosses it. The input goes in as pointer and length, the segmentation comes back
+ * in arrays the caller owns, and the library keeps its scratch space per thread, so a call allocates nothing
+ * once a thread has segmented an input of that size.
+ *
+ * A dictionary handle may be used by any number of threads at once. Failures are reported as status codes, never
+ * crossing the boundary as C++ exceptions; sb_last_error says more about the last one on the calling thread.
+ */
+
+#ifndef SENTENCE_BREAKER_H
+#define SENTENCE_BREAKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(SENTENCE_BREAKER_BUILD_LIBRARY)
+#define SB_API __attribute__((visibility("default")))
+#else
+#define SB_API
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Bumped whenever a declaration below changes incompatibly */
+#define SB_API_VERSION 1
+
+typedef struct sb_dictionary sb_dictionary;
+
+/* Status codes */
+#define SB_OK                 0
+#define SB_IMPOSSIBLE_MATCH   1   /* No split exists, the arrays hold the words up to failure_offset */
+#define SB_BUFFER_TOO_SMALL   2   /* More words than capacity, num_words tells how many; nothing was written */
+#define SB_INVALID_ARGUMENT  -1   /* Null pointer, unknown mode or policy, input of 4 GiB or more */
+#define SB_ERROR             -2   /* Out of memory, unreadable or bad dictionary file; see sb_last_error */
+
+/* Modes, as SENTENCE_BREAKER::SEGMENTATION_MODE */
+#define SB_MODE_GREEDY        0
+#define SB_MODE_FEWEST_WORDS  1
+#define SB_MODE_UNIGRAM_COST  2
+
+/* Policies for letters no dictionary word covers, as SENTENCE_BREAKER::UNKNOWN_POLICY */
+#define SB_UNKNOWN_FAIL       0
+#define SB_UNKNOWN_EMIT       1
+
+/* Flags of sb_dictionary_open */
+#define SB_OPEN_MINIMIZE      1u  /* Load the word list as a minimized DAWG */
+#define SB_OPEN_MATCH_LINKS   2u  /* Build match links, see DICTIONARY::LOAD_OPTIONS::match_links */
+
+typedef struct sb_segmentation
+{
+	size_t num_words;       /* Words written to word_ends, or needed when the status is SB_BUFFER_TOO_SMALL */
+	size_t failure_offset;  /* Where segmentation got stuck, the input length on success */
+	size_t num_unknown;     /* Words flagged unknown, only with SB_UNKNOWN_EMIT */
+} sb_segmentation;
+
+SB_API unsigned sb_api_version(void);
+
+/* Loads a word list, whitespace separated words with optional counts (see DICTIONARY). Null on failure. */
+SB_API sb_dictionary * sb_dictionary_open(const char * word_list, unsigned flags);
+
+/* Maps a dictionary compiled by dictc, which is shared with every other process that maps the same file. Null on
+ * failure. */
+SB_API sb_dictionary * sb_dictionary_open_compiled(const char * compiled_path);
+
+/* Null is fine. No sb_segment call on the handle may still be running. */
+SB_API void sb_dictionary_close(sb_dictionary * dict);
+
+/* Splits text[0, length) into dictionary words, like try_break_sentence: the input is meant to be one token, as
+ * whitespace is just another run of non-letters and comes back as a word of its own.
+ *
+ * word_ends[i] receives the end offset of word i, so word i is text[word_ends[i - 1], word_ends[i]) with
+ * word_ends[-1] taken as 0. unknown may be null; otherwise unknown[i] is 1 for a word flagged unknown, 0 for a
+ * dictionary word or a run of non-letters. Both arrays need room for capacity words; an input of n bytes never
+ * has more than n words. result must not be null. */
+SB_API int sb_segment(const sb_dictionary * dict, const char * text, size_t length, int mode, int policy,
+	uint32_t * word_ends, uint8_t * unknown, size_t capacity, sb_segmentation * result);
+
+/* What went wrong in the latest failed call on this thread, valid until the next call. Never null. */
+SB_API const char * sb_last_error(void);
+
+#ifdef __cplusplus
+} /* End extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,183 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace SENTENCE_BREAKER
+{
+
+namespace
+{
+
+// Counters of the running threads, and the sum of those that have exited.
+struct REGISTRY
+{
+	std::mutex mutex;
+	std::vector<STATS_DETAIL::THREAD_COUNTERS *> live;
+	SEGMENTATION_STATS retired;
+};
+
+// Never destroyed, threads may still exit (and retire their counters) while static objects are torn down
+REGISTRY & registry()
+{
+	static REGISTRY * const instance = new REGISTRY();
+	return *instance;
+}
+
+volatile std::sig_atomic_t dump_requested = 0;
+
+extern "C" void request_stats_dump(int)
+{
+	dump_requested = 1;
+}
+
+} // End Anonymous Namespace
+
+SEGMENTATION_STATS::SEGMENTATION_STATS()
+:
+	calls(0),
+	characters(0),
+	trie_steps(0),
+	rollbacks(0),
+	rolled_back_chars(0),
+	impossible_matches(0),
+	unknown_words(0),
+	words(0),
+	word_lengths()
+{
+
+}
+
+SEGMENTATION_STATS & SEGMENTATION_STATS::operator+=(const SEGMENTATION_STATS & other)
+{
+	calls              += other.calls;
+	characters         += other.characters;
+	trie_steps         += other.trie_steps;
+	rollbacks          += other.rollbacks;
+	rolled_back_chars  += other.rolled_back_chars;
+	impossible_matches += other.impossible_matches;
+	unknown_words      += other.unknown_words;
+	words              += other.words;
+	for (std::size_t bucket = 0; bucket < WORD_LENGTH_BUCKETS; ++bucket)
+	{
+		word_lengths[bucket] += other.word_lengths[bucket];
+	}
+	return *this;
+}
+
+SEGMENTATION_STATS collect_stats()
+{
+	REGISTRY & stats_registry = registry();
+	std::lock_guard<std::mutex> lock(stats_registry.mutex);
+	SEGMENTATION_STATS total = stats_registry.retired;
+	for (const STATS_DETAIL::THREAD_COUNTERS * counters : stats_registry.live)
+	{
+		total += counters->snapshot();
+	}
+	return total;
+}
+
+void reset_stats()
+{
+	REGISTRY & stats_registry = registry();
+	std::lock_guard<std::mutex> lock(stats_registry.mutex);
+	stats_registry.retired = SEGMENTATION_STATS();
+	for (STATS_DETAIL::THREAD_COUNTERS * counters : stats_registry.live)
+	{
+		counters->clear();
+	}
+}
+
+void write_stats(std::FILE * out, const SEGMENTATION_STATS & stats)
+{
+	std::fprintf(out, "calls %llu\n",              static_cast<unsigned long long>(stats.calls));
+	std::fprintf(out, "characters %llu\n",         static_cast<unsigned long long>(stats.characters));
+	std::fprintf(out, "trie_steps %llu\n",         static_cast<unsigned long long>(stats.trie_steps));
+	std::fprintf(out, "rollbacks %llu\n",          static_cast<unsigned long long>(stats.rollbacks));
+	std::fprintf(out, "rolled_back_chars %llu\n",  static_cast<unsigned long long>(stats.rolled_back_chars));
+	std::fprintf(out, "impossible_matches %llu\n", static_cast<unsigned long long>(stats.impossible_matches));
+	std::fprintf(out, "unknown_words %llu\n",      static_cast<unsigned long long>(stats.unknown_words));
+	std::fprintf(out, "words %llu\n",              static_cast<unsigned long long>(stats.words));
+	for (std::size_t bucket = 0; bucket < WORD_LENGTH_BUCKETS; ++bucket)
+	{
+		if (stats.word_lengths[bucket] != 0)
+		{
+			std::fprintf(out, "word_length[%zu%s] %llu\n", bucket, bucket + 1 == WORD_LENGTH_BUCKETS ? "+" : "",
+				static_cast<unsigned long long>(stats.word_lengths[bucket]));
+		}
+	}
+	std::fflush(out);
+}
+
+void install_stats_signal_handler(int signal)
+{
+	std::signal(signal, request_stats_dump);
+}
+
+bool take_stats_dump_request()
+{
+	if (dump_requested == 0)
+	{
+		return false;
+	}
+	dump_requested = 0;
+	return true;
+}
+
+namespace STATS_DETAIL
+{
+
+THREAD_COUNTERS::THREAD_COUNTERS()
+{
+	clear();
+	REGISTRY & stats_registry = registry();
+	std::lock_guard<std::mutex> lock(stats_registry.mutex);
+	stats_registry.live.push_back(this);
+}
+
+THREAD_COUNTERS::~THREAD_COUNTERS()
+{
+	REGISTRY & stats_registry = registry();
+	std::lock_guard<std::mutex> lock(stats_registry.mutex);
+	stats_registry.retired += snapshot();
+	stats_registry.live.erase(std::find(stats_registry.live.begin(), stats_registry.live.end(), this));
+}
+
+SEGMENTATION_STATS THREAD_COUNTERS::snapshot() const
+{
+	SEGMENTATION_STATS stats;
+	stats.calls              = calls.load(std::memory_order_relaxed);
+	stats.characters         = characters.load(std::memory_order_relaxed);
+	stats.trie_steps         = trie_steps.load(std::memory_order_relaxed);
+	stats.rollbacks          = rollbacks.load(std::memory_order_relaxed);
+	stats.rolled_back_chars  = rolled_back_chars.load(std::memory_order_relaxed);
+	stats.impossible_matches = impossible_matches.load(std::memory_order_relaxed);
+	stats.unknown_words      = unknown_words.load(std::memory_order_relaxed);
+	stats.words              = words.load(std::memory_order_relaxed);
+	for (std::size_t bucket = 0; bucket < WORD_LENGTH_BUCKETS; ++bucket)
+	{
+		stats.word_lengths[bucket] = word_lengths[bucket].load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+void THREAD_COUNTERS::clear()
+{
+	calls.store(0, std::memory_order_relaxed);
+	characters.store(0, std::memory_order_relaxed);
+	trie_steps.store(0, std::memory_order_relaxed);
+	rollbacks.store(0, std::memory_order_relaxed);
+	rolled_back_chars.store(0, std::memory_order_relaxed);
+	impossible_matches.store(0, std::memory_order_relaxed);
+	unknown_words.store(0, std::memory_order_relaxed);
+	words.store(0, std::memory_order_relaxed);
+	for (std::size_t bucket = 0; bucket < WORD_LENGTH_BUCKETS; ++bucket)
+	{
+		word_lengths[bucket].store(0, std::memory_order_relaxed);
+	}
+}
+
+} // End Namespace STATS_DETAIL
+
+} // End Namespace
@@ -0,0 +1,122 @@
+#ifndef SENTENCE_BREAKER_STATS_HPP
+#define SENTENCE_BREAKER_STATS_HPP
+
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace SENTENCE_BREAKER
+{
+
+// Hot path counters of the dictionary and the segmentation engines.
+//
+// Only compiled in when SENTENCE_BREAKER_STATS is defined (make STATS=1). Otherwise the counting macros expand to
+// nothing and collect_stats() returns zeros, so a regular build pays nothing for them.
+//
+// Every thread counts into its own counters, which only that thread writes, so counting is a plain add with no locked
+// instruction and no cache line bouncing between cores. collect_stats() merges all threads on demand, counts of
+// threads that have exited included.
+#ifdef SENTENCE_BREAKER_STATS
+constexpr bool STATS_ENABLED = true;
+#else
+constexpr bool STATS_ENABLED = false;
+#endif
+
+// Longer words all go to the last bucket of the histogram
+constexpr std::size_t WORD_LENGTH_BUCKETS = 33;
+
+// A snapshot of the counters
+struct SEGMENTATION_STATS
+{
+	SEGMENTATION_STATS();
+
+	SEGMENTATION_STATS & operator+=(const SEGMENTATION_STATS & other);
+
+	std::uint64_t calls;               // break_sentence calls
+	std::uint64_t characters;          // Characters given to break_sentence
+	std::uint64_t trie_steps;          // Trie nodes visited, by prefix_match and by cursors
+	std::uint64_t rollbacks;           // Greedy engine falling back to its last exact match
+	std::uint64_t rolled_back_chars;   // Characters read past the last exact match, read again after a rollback
+	std::uint64_t impossible_matches;  // Inputs with no split, thrown or returned as SEGMENTATION_STATUS
+	std::uint64_t unknown_words;       // Runs emitted as unknown words by UNKNOWN_POLICY::EMIT_UNKNOWN
+	std::uint64_t words;               // Dictionary words found by the engines, unknown words not included
+	std::uint64_t word_lengths[WORD_LENGTH_BUCKETS];
+};
+
+// Sum of every thread's counters
+SEGMENTATION_STATS collect_stats();
+
+// Zeroes every thread's counters. Counts made by other threads while this runs may survive it.
+void reset_stats();
+
+// One "name value" line per counter, and one per non empty histogram bucket
+void write_stats(std::FILE * out, const SEGMENTATION_STATS & stats);
+
+// Makes `signal` (SIGUSR1 by default) request a dump. Long running loops poll take_stats_dump_request() at convenient
+// points, segment_stream does at every chunk, and write the counters out; nothing is done inside the handler.
+void install_stats_signal_handler(int signal = SIGUSR1);
+
+// Whether a dump was requested since the last call
+bool take_stats_dump_request();
+
+namespace STATS_DETAIL
+{
+
+// The live counters of one thread, registered for collect_stats() while the thread runs.
+// Atomic only so that collect_stats() may read them while the owner counts, the owner's add is a load and a store.
+struct THREAD_COUNTERS
+{
+	THREAD_COUNTERS();
+	~THREAD_COUNTERS();
+
+	THREAD_COUNTERS(const THREAD_COUNTERS &) = delete;
+	THREAD_COUNTERS & operator=(const THREAD_COUNTERS &) = delete;
+
+	SEGMENTATION_STATS snapshot() const;
+	void clear();
+
+	std::atomic<std::uint64_t> calls;
+	std::atomic<std::uint64_t> characters;
+	std::atomic<std::uint64_t> trie_steps;
+	std::atomic<std::uint64_t> rollbacks;
+	std::atomic<std::uint64_t> rolled_back_chars;
+	std::atomic<std::uint64_t> impossible_matches;
+	std::atomic<std::uint64_t> unknown_words;
+	std::atomic<std::uint64_t> words;
+	std::atomic<std::uint64_t> word_lengths[WORD_LENGTH_BUCKETS];
+};
+
+inline THREAD_COUNTERS & thread_counters()
+{
+	static thread_local THREAD_COUNTERS counters;
+	return counters;
+}
+
+inline void add(std::atomic<std::uint64_t> & counter, std::uint64_t n)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void add_word(std::size_t length)
+{
+	THREAD_COUNTERS & counters = thread_counters();
+	add(counters.words, 1);
+	add(counters.word_lengths[length < WORD_LENGTH_BUCKETS ? length : WORD_LENGTH_BUCKETS - 1], 1);
+}
+
+} // End Namespace STATS_DETAIL
+
+} // End Namespace
+
+#ifdef SENTENCE_BREAKER_STATS
+#define SENTENCE_BREAKER_COUNT(counter, n) \
+	::SENTENCE_BREAKER::STATS_DETAIL::add(::SENTENCE_BREAKER::STATS_DETAIL::thread_counters().counter, (n))
+#define SENTENCE_BREAKER_COUNT_WORD(length) ::SENTENCE_BREAKER::STATS_DETAIL::add_word(length)
+#else
+#define SENTENCE_BREAKER_COUNT(counter, n) ((void)0)
+#define SENTENCE_BREAKER_COUNT_WORD(length) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,129 @@
+// dictc - compiles a word list into a dictionary file that DICTIONARY can map instead of parse.
+//
+// Usage: dictc [--minimize | --links] [--header name] [filters] [--report] <word list> <compiled dictionary | header>
+//
+// --minimize stores the minimized DAWG instead of the plain trie. Either way the node count and size go to stderr.
+// --links stores match links (failure and output links, plain trie only) so the lattice engines need one pass.
+// --header writes a C++ header with the trie as constexpr tables instead, SENTENCE_BREAKER::EMBEDDED_TABLES::name,
+// to compile the dictionary into a program (see DICTIONARY(const EMBEDDED &) and make embedded).
+// Filters, see DICTIONARY::LOAD_OPTIONS: --min-length n, --max-length n (code points), --letters-only,
+// --alphabet chars, --min-count n (after duplicates and case variants are merged).
+// --report writes DICTIONARY::REPORT to stderr: what the filters dropped, words, nodes, bytes, depth and branching.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <exception>
+#include "../dictionary.hpp"
+
+using namespace SENTENCE_BREAKER;
+
+namespace
+{
+
+int usage(const char * argv0)
+{
+	std::cerr << "Usage: " << argv0 << " [--minimize | --links] [--header name] [--min-length n] [--max-length n] [--letters-only] [--alphabet chars] [--min-count n] [--report] <word list> <compiled dictionary | header>" << std::endl;
+	return 2;
+}
+
+bool parse_count(const char * text, unsigned long & value)
+{
+	char * end = nullptr;
+	value = std::strtoul(text, &end, 10);
+	return end != text && *end == '\0';
+}
+
+} // End Anonymous Namespace
+
+int main(int argc, char ** argv)
+{
+	DICTIONARY::LOAD_OPTIONS options;
+	const char * header_name = nullptr;
+	bool print_report = false;
+	unsigned long value = 0;
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; ++arg)
+	{
+		if (std::strcmp(argv[arg], "--minimize") == 0)
+		{
+			options.minimize = true;
+		}
+		else if (std::strcmp(argv[arg], "--links") == 0)
+		{
+			options.match_links = true;
+		}
+		else if (std::strcmp(argv[arg], "--header") == 0 && arg + 1 < argc)
+		{
+			header_name = argv[++arg];
+		}
+		else if (std::strcmp(argv[arg], "--min-length") == 0 && arg + 1 < argc)
+		{
+			if (!parse_count(argv[++arg], value))
+			{
+				return usage(argv[0]);
+			}
+			options.min_length = value;
+		}
+		else if (std::strcmp(argv[arg], "--max-length") == 0 && arg + 1 < argc)
+		{
+			if (!parse_count(argv[++arg], value))
+			{
+				return usage(argv[0]);
+			}
+			options.max_length = value;
+		}
+		else if (std::strcmp(argv[arg], "--letters-only") == 0)
+		{
+			options.letters_only = true;
+		}
+		else if (std::strcmp(argv[arg], "--alphabet") == 0 && arg + 1 < argc)
+		{
+			options.alphabet = argv[++arg];
+		}
+		else if (std::strcmp(argv[arg], "--min-count") == 0 && arg + 1 < argc)
+		{
+			if (!parse_count(argv[++arg], value) || value > ~std::uint32_t(0))
+			{
+				return usage(argv[0]);
+			}
+			options.min_count = static_cast<std::uint32_t>(value);
+		}
+		else if (std::strcmp(argv[arg], "--report") == 0)
+		{
+			print_report = true;
+		}
+		else
+		{
+			return usage(argv[0]);
+		}
+	}
+	if (argc - arg != 2)
+	{
+		return usage(argv[0]);
+	}
+
+	try
+	{
+		DICTIONARY dict(argv[arg], options);
+		if (header_name != nullptr)
+		{
+			dict.save_header(argv[arg + 1], header_name);
+		}
+		else
+		{
+			dict.save(argv[arg + 1]);
+		}
+		std::cerr << argv[arg + 1] << ": " << dict.num_nodes() << " nodes, " << dict.byte_size() << " bytes" << std::endl;
+		if (print_report)
+		{
+			DICTIONARY::write_report(stderr, dict.report());
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cerr << argv[0] << ": " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
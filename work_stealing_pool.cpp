@@ -0,0 +1,195 @@
+#include "work_stealing_pool.hpp"
+
+#include <algorithm>
+
+namespace SENTENCE_BREAKER
+{
+
+WORK_STEALING_POOL::WORK_STEALING_POOL(unsigned n_workers)
+:
+	m_num_workers(n_workers != 0 ? n_workers : std::max(1u, std::thread::hardware_concurrency())),
+	m_ranges(new RANGE[m_num_workers]),
+	m_threads(),
+	m_mutex(),
+	m_start_condition(),
+	m_done_condition(),
+	m_generation(0),
+	m_busy_threads(0),
+	m_stopping(false),
+	m_task(nullptr),
+	m_failed(false),
+	m_error()
+{
+	for (unsigned worker = 0; worker < m_num_workers; ++worker)
+	{
+		m_ranges[worker].begin = 0;
+		m_ranges[worker].end   = 0;
+	}
+
+	m_threads.reserve(m_num_workers - 1);
+	for (unsigned worker = 1; worker < m_num_workers; ++worker)
+	{
+		m_threads.emplace_back(&WORK_STEALING_POOL::thread_main, this, worker);
+	}
+}
+
+WORK_STEALING_POOL::~WORK_STEALING_POOL()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_start_condition.notify_all();
+	for (auto & thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void WORK_STEALING_POOL::run(std::size_t n_tasks, const TASK & task)
+{
+	if (n_tasks == 0)
+	{
+		return;
+	}
+
+	for (unsigned worker = 0; worker < m_num_workers; ++worker)
+	{
+		std::lock_guard<std::mutex> lock(m_ranges[worker].mutex);
+		m_ranges[worker].begin = n_tasks * worker / m_num_workers;
+		m_ranges[worker].end   = n_tasks * (worker + 1) / m_num_workers;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_failed = false;
+		m_error = nullptr;
+		m_busy_threads = static_cast<unsigned>(m_threads.size());
+		++m_generation;
+	}
+	m_start_condition.notify_all();
+
+	work(0);
+
+	std::exception_ptr error;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done_condition.wait(lock, [this] { return m_busy_threads == 0; });
+		m_task = nullptr;
+		error = m_error;
+		m_error = nullptr;
+	}
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+void WORK_STEALING_POOL::thread_main(unsigned worker)
+{
+	std::size_t seen_generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start_condition.wait(lock, [&] { return m_stopping || m_generation != seen_generation; });
+			if (m_stopping)
+			{
+				return;
+			}
+			seen_generation = m_generation;
+		}
+
+		work(worker);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_busy_threads == 0)
+			{
+				m_done_condition.notify_one();
+			}
+		}
+	}
+}
+
+void WORK_STEALING_POOL::work(unsigned worker)
+{
+	const TASK & task = *m_task;
+	while (!m_failed.load(std::memory_order_relaxed))
+	{
+		std::size_t first, last;
+		if (!pop(worker, first, last))
+		{
+			// No task creates new ones, so once every range is empty only grains already taken are left to finish.
+			if (!steal(worker))
+			{
+				return;
+			}
+			continue;
+		}
+
+		try
+		{
+			for (std::size_t index = first; index != last; ++index)
+			{
+				task(index, worker);
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_error)
+			{
+				m_error = std::current_exception();
+			}
+			m_failed = true;
+			return;
+		}
+	}
+}
+
+bool WORK_STEALING_POOL::pop(unsigned worker, std::size_t & first, std::size_t & last)
+{
+	RANGE & range = m_ranges[worker];
+	std::lock_guard<std::mutex> lock(range.mutex);
+	if (range.begin == range.end)
+	{
+		return false;
+	}
+	first = range.begin;
+	last  = std::min(range.begin + GRAIN, range.end);
+	range.begin = last;
+	return true;
+}
+
+// Takes the back half of the first non-empty range after the thief's own, so thieves spread over different victims.
+bool WORK_STEALING_POOL::steal(unsigned thief)
+{
+	for (unsigned offset = 1; offset < m_num_workers; ++offset)
+	{
+		RANGE & victim = m_ranges[(thief + offset) % m_num_workers];
+		std::size_t stolen_begin, stolen_end;
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			const std::size_t remaining = victim.end - victim.begin;
+			if (remaining == 0)
+			{
+				continue;
+			}
+			stolen_end   = victim.end;
+			stolen_begin = victim.end - (remaining + 1) / 2;
+			victim.end   = stolen_begin;
+		}
+
+		// Other thieves skip the thief's range while it is empty, from here on it can be stolen from like any other.
+		RANGE & own = m_ranges[thief];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		own.begin = stolen_begin;
+		own.end   = stolen_end;
+		return true;
+	}
+	return false;
+}
+
+} // End Namespace
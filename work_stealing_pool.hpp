@@ -0,0 +1,82 @@
+#ifndef SENTENCE_BREAKER_WORK_STEALING_POOL_HPP
+#define SENTENCE_BREAKER_WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SENTENCE_BREAKER
+{
+
+// Fixed set of threads that runs indexed tasks.
+//
+// Each run splits [0, n_tasks) into one contiguous range per worker. A worker takes small grains from the front of its
+// own range and, once that is empty, steals the back half of another worker's range, so a few slow tasks (long inputs)
+// cannot leave the other cores idle. The calling thread is worker 0, the pool only starts num_workers() - 1 threads.
+//
+// run() is not reentrant: one run at a time, and never from inside a task.
+class WORK_STEALING_POOL
+{
+public:
+	// task(index, worker), worker is in [0, num_workers()) and lets tasks index per worker buffers without locking.
+	typedef std::function<void(std::size_t, unsigned)> TASK;
+
+	// n_workers == 0 means one worker per hardware thread
+	explicit WORK_STEALING_POOL(unsigned n_workers = 0);
+	~WORK_STEALING_POOL();
+
+	WORK_STEALING_POOL(const WORK_STEALING_POOL &) = delete;
+	WORK_STEALING_POOL & operator=(const WORK_STEALING_POOL &) = delete;
+
+	unsigned num_workers() const
+	{
+		return m_num_workers;
+	}
+
+	// Blocks until task has run for every index. If a task throws, the remaining tasks are skipped and the first
+	// exception is rethrown here once every worker has stopped.
+	void run(std::size_t n_tasks, const TASK & task);
+
+private:
+	static constexpr std::size_t GRAIN      = 8;
+	static constexpr std::size_t CACHE_LINE = 64;
+
+	// Remaining tasks of one worker, [begin, end). Padded so that neighbouring workers don't share a cache line.
+	struct RANGE
+	{
+		std::mutex mutex;
+		std::size_t begin;
+		std::size_t end;
+		char padding[CACHE_LINE];
+	};
+
+	void thread_main(unsigned worker);
+	void work(unsigned worker);
+	bool pop(unsigned worker, std::size_t & first, std::size_t & last);
+	bool steal(unsigned thief);
+
+	const unsigned m_num_workers;
+	std::unique_ptr<RANGE[]> m_ranges;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_start_condition;
+	std::condition_variable m_done_condition;
+	std::size_t m_generation;  // Bumped by every run, wakes the threads up
+	unsigned m_busy_threads;
+	bool m_stopping;
+	const TASK * m_task;
+
+	std::atomic<bool> m_failed;
+	std::exception_ptr m_error;
+};
+
+} // End Namespace
+
+#endif